@@ -1,9 +1,31 @@
 #pragma once
 
-#include "Box.h"
+#include "Position.h"
+
+namespace opening_book {
+class Book;
+}
+
+namespace telemetry {
+class Sink;
+}
 
 struct AiContext {
   const Color color;
   ostream& log;
   double total_time{0.0};
+  ColorWeights weights{color};
+  // searches of this game derive their random streams from this seed
+  uint32_t seed{123456789};
+  // random rollouts played from each new leaf of the search tree
+  int leaf_rollouts{1};
+  // from this turn on the root search is a sequential halving of the
+  // children of best prior, meant for the short budgets of the late game
+  int halving_turn{numeric_limits<int>::max()};
+  // threads of the endgame solver, 0 for one per core
+  int endgame_threads{0};
+  // moves of the first placements, probed before searching
+  const opening_book::Book* book{nullptr};
+  // one record per move, for offline analysis
+  telemetry::Sink* telemetry{nullptr};
 };
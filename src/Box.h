@@ -19,64 +19,56 @@ constexpr Orientation HORIZONTAL{'h'};
 
 using Tile = string;
 
-#if defined(__APPLE__)
-using Bitboard = bitset<TOTAL_DOTS>;
-#else
+// 320 bits stored as plain words so that tile tables can be built at compile
+// time; the hot queries go through SSE on x86.
 class Bitboard {
  public:
   inline static constexpr int SIZE{3};
+  inline static constexpr int WORDS{2 * SIZE};
 
-  Bitboard() { reset(); }
+  constexpr Bitboard() = default;
 
   // Reset all bits to 0
-  void reset() {
-    for (auto& d : data) {
-      d = _mm_setzero_si128();
+  constexpr void reset() {
+    for (auto& w : words) {
+      w = 0;
     }
   }
 
   // Bitwise OR-assignment operator
-  Bitboard& operator|=(const Bitboard& other) {
-    for (size_t i = 0; i < SIZE; ++i) {
-      data[i] = _mm_or_si128(data[i], other.data[i]);
+  constexpr Bitboard& operator|=(const Bitboard& other) {
+    for (int i = 0; i < WORDS; ++i) {
+      words[i] |= other.words[i];
     }
     return *this;
   }
 
   // Bitwise NOT operator
-  Bitboard operator~() const {
+  constexpr Bitboard operator~() const {
     Bitboard result;
-    __m128i all_ones = _mm_set1_epi32(-1);
-    for (size_t i = 0; i < SIZE; ++i) {
-      result.data[i] = _mm_xor_si128(data[i], all_ones);
+    for (int i = 0; i < WORDS; ++i) {
+      result.words[i] = ~words[i];
     }
     return result;
   }
 
   // Equality operator
-  bool operator==(const Bitboard& other) const {
-    for (size_t i = 0; i < SIZE; ++i) {
-      __m128i cmp = _mm_cmpeq_epi64(data[i], other.data[i]);
-      if (_mm_movemask_epi8(cmp) != 0xFFFF) {
-        return false;
-      }
-    }
-    return true;
-  }
+  constexpr bool operator==(const Bitboard& other) const = default;
 
   // Bitwise AND operator
-  Bitboard operator&(const Bitboard& other) const {
+  constexpr Bitboard operator&(const Bitboard& other) const {
     Bitboard result;
-    for (size_t i = 0; i < SIZE; ++i) {
-      result.data[i] = _mm_and_si128(data[i], other.data[i]);
+    for (int i = 0; i < WORDS; ++i) {
+      result.words[i] = words[i] & other.words[i];
     }
     return result;
   }
 
   int count_matches(const Bitboard& other) const {
     int count{0};
-    for (size_t i = 0; i < SIZE; ++i) {
-      __m128i result = _mm_and_si128(data[i], other.data[i]);
+#if !defined(__APPLE__)
+    for (int i = 0; i < SIZE; ++i) {
+      __m128i result = _mm_and_si128(load(i), other.load(i));
 
       // Extract the 128-bit result into two 64-bit integers
       uint64_t lower = _mm_extract_epi64(result, 0);
@@ -84,59 +76,58 @@ class Bitboard {
 
       count += __builtin_popcountll(lower) + __builtin_popcountll(upper);
     }
+#else
+    for (int i = 0; i < WORDS; ++i) {
+      count += popcount(words[i] & other.words[i]);
+    }
+#endif
     return count;
   }
 
   bool any_matches(const Bitboard& other) const {
-    for (size_t i = 0; i < SIZE; ++i) {
-      __m128i result = _mm_and_si128(data[i], other.data[i]);
+#if !defined(__APPLE__)
+    for (int i = 0; i < SIZE; ++i) {
+      __m128i result = _mm_and_si128(load(i), other.load(i));
       if (!_mm_testz_si128(result, result)) return true;
     }
+#else
+    for (int i = 0; i < WORDS; ++i) {
+      if (words[i] & other.words[i]) return true;
+    }
+#endif
     return false;
   }
 
   // Set a bit at a specific position
-  void set(size_t pos) {
-    apply_mask(pos, [](auto a, auto b) { return _mm_or_si128(a, b); });
-  }
+  constexpr void set(size_t pos) { words[pos / 64] |= mask(pos); }
 
   // Clear a specific bit at a given position
-  void reset(size_t pos) {
-    apply_mask(pos, [](auto a, auto b) { return _mm_andnot_si128(b, a); });
-  }
+  constexpr void reset(size_t pos) { words[pos / 64] &= ~mask(pos); }
 
   // Toggle a bit at a specific position
-  void toggle(size_t pos) {
-    apply_mask(pos, [](auto a, auto b) { return _mm_xor_si128(a, b); });
-  }
+  constexpr void toggle(size_t pos) { words[pos / 64] ^= mask(pos); }
 
   // Check if a specific bit is set
-  bool test(size_t pos) const {
-    __m128i mask = create_mask(pos);
-    __m128i result = _mm_and_si128(data[pos / 128], mask);
-    return !_mm_testz_si128(result, result);
+  constexpr bool test(size_t pos) const {
+    return (words[pos / 64] & mask(pos)) != 0;
   }
 
   // Check if any bit is set
-  bool any() const {
-    for (const auto& d : data) {
-      if (!_mm_testz_si128(d, d)) {
-        return true;
-      }
+  constexpr bool any() const {
+    for (auto w : words) {
+      if (w) return true;
     }
     return false;
   }
 
   // Check if all bits are zero
-  bool none() const { return !any(); }
+  constexpr bool none() const { return !any(); }
 
   // Count the number of set bits
-  int count() const {
+  constexpr int count() const {
     int total_count = 0;
-    for (const auto& d : data) {
-      uint64_t lower = _mm_cvtsi128_si64(d);
-      uint64_t upper = _mm_extract_epi64(d, 1);
-      total_count += popcount(lower) + popcount(upper);
+    for (auto w : words) {
+      total_count += popcount(w);
     }
     return total_count;
   }
@@ -151,26 +142,16 @@ class Bitboard {
   }
 
  private:
-  alignas(16) __m128i data[3];
-
-  // Helper function to create a mask for a specific bit position
-  __m128i create_mask(size_t pos) const {
-    size_t bit_offset = pos % 128;
-    if (bit_offset < 64) {
-      return _mm_set_epi64x(0, 1ULL << bit_offset);
-    } else {
-      return _mm_set_epi64x(1ULL << (bit_offset - 64), 0);
-    }
-  }
+  alignas(16) array<uint64_t, WORDS> words{};
+
+  static constexpr uint64_t mask(size_t pos) { return 1ULL << (pos % 64); }
 
-  // Helper function to apply a mask operation at a specific index
-  template <typename Operation>
-  void apply_mask(size_t pos, Operation op) {
-    __m128i mask = create_mask(pos);
-    data[pos / 128] = op(data[pos / 128], mask);
+#if !defined(__APPLE__)
+  __m128i load(int i) const {
+    return _mm_load_si128(reinterpret_cast<const __m128i*>(&words[2 * i]));
   }
-};
 #endif
+};
 
 // Variadic template function to set multiple bits in a Bitboard
 template <typename... Bits>
@@ -181,7 +162,7 @@ constexpr Bitboard mk_bitboard(Bits... bits) {
   return bitboard;
 }
 
-inline int get_dot(int r, int c) { return r * COLS + c; }
+constexpr int get_dot(int r, int c) { return r * COLS + c; }
 
 inline string show_dot(int dot) {
   ostringstream out;
@@ -215,14 +196,14 @@ struct PlayerMove {
     return orientation == VERTICAL ? (2 * dot + 1) : (2 * dot);
   }
 
-  static int code(int dot, Orientation o) {
+  static constexpr int code(int dot, Orientation o) {
     return o == VERTICAL ? (2 * dot + 1) : (2 * dot);
   }
 };
 
 using ChanceMove = Tile;
 
-inline int parse_dot(const string& s) {
+constexpr int parse_dot(std::string_view s) {
   return (s[0] - 'A') * COLS + s[1] - 'a';
 }
 
@@ -242,15 +223,15 @@ constexpr Player PLAYER_1 = '1';
 constexpr Player PLAYER_2 = '2';
 
 struct TileInfo {
-  array<pair<int, int>, TILE_DOTS> siblings;
+  array<pair<int, int>, TILE_DOTS> siblings{};
   Bitboard bitboard;
   Bitboard neighbors_bitboard;
-  mutable int code;
-  int dot;
-  Orientation orientation;
+  int code{-1};
+  int dot{-1};
+  Orientation orientation{'?'};
 
-  bool valid() const { return bitboard.any(); }
-  void clear() {
+  constexpr bool valid() const { return bitboard.any(); }
+  constexpr void clear() {
     bitboard.reset();
     neighbors_bitboard.reset();
   }
@@ -312,17 +293,73 @@ struct Stats {
   }
 };
 
-extern const vector<TileInfo> VERTICAL_TILES_INFO;
-extern const vector<TileInfo> HORIZONTAL_TILES_INFO;
-extern const vector<const TileInfo*> ALL_TILES_INFO;
 constexpr int ALL_TILES_COUNT{434};
+// All tiles on the board indexed by TileInfo::code, vertical ones first
+extern const array<TileInfo, ALL_TILES_COUNT> TILES_INFO;
+// TileInfo::code of each PlayerMove::code(), -1 for tiles off the board
+extern const array<int16_t, 2 * TOTAL_DOTS> TILES_CODES;
 extern const TileInfo* const CENTER_TILE_INFO;
+
+inline const TileInfo* get_tile_info(int dot, Orientation orientation) {
+  auto code = TILES_CODES[PlayerMove::code(dot, orientation)];
+  return code != -1 ? &TILES_INFO[code] : nullptr;
+}
+
+inline const TileInfo* get_tile_info(const PlayerMove& move) {
+  return get_tile_info(move.dot, move.orientation);
+}
+
+// Mirror images of the board, composed with xor: MIRROR_COLS reverses the
+// columns, MIRROR_ROWS the rows and ROTATE_180 both. Each is its own inverse.
+constexpr int IDENTITY{0};
+constexpr int MIRROR_COLS{1};
+constexpr int MIRROR_ROWS{2};
+constexpr int ROTATE_180{MIRROR_COLS | MIRROR_ROWS};
+constexpr int SYMMETRIES{4};
+
+constexpr int mirror_dot(int dot, int symmetry) {
+  int r = dot / COLS;
+  int c = dot % COLS;
+  if (symmetry & MIRROR_COLS) c = COLS - 1 - c;
+  if (symmetry & MIRROR_ROWS) r = ROWS - 1 - r;
+  return get_dot(r, c);
+}
+
+// A mirror across a single axis maps slot i of a tile to slot 5 - i.
+constexpr bool reverses_slots(int symmetry) {
+  return symmetry == MIRROR_COLS || symmetry == MIRROR_ROWS;
+}
+
+// TileInfo::code of the mirror image of each tile
+extern const array<array<int16_t, ALL_TILES_COUNT>, SYMMETRIES>
+    TILES_MIRROR_CODES;
+
+inline const TileInfo* mirror_tile_info(const TileInfo* tile_info,
+                                        int symmetry) {
+  return &TILES_INFO[TILES_MIRROR_CODES[symmetry][tile_info->code]];
+}
+
 constexpr int TILES_PERMUTATIONS_COUNT{6 * 5 * 4 * 3 * 2 * 1};
-extern const vector<Tile> TILES_PERMUTATIONS;
+// Colors of the tile slots, not null-terminated
+using TileColors = array<char, TILE_DOTS>;
+// All tiles in lexicographic order
+extern const array<TileColors, TILES_PERMUTATIONS_COUNT> TILES_PERMUTATIONS;
+
+inline string_view show_tile(const TileColors& colors) {
+  return {colors.data(), colors.size()};
+}
+
+// Index of each tile with its slots in reverse order
+extern const array<int16_t, TILES_PERMUTATIONS_COUNT> TILES_REVERSED;
+
+inline int mirror_tile_index(int index, int symmetry) {
+  return reverses_slots(symmetry) ? TILES_REVERSED[index] : index;
+}
 
 inline int find_tile_index(const Tile& tile) {
-  if (auto it = ranges::lower_bound(TILES_PERMUTATIONS, tile);
-      it != TILES_PERMUTATIONS.end() && *it == tile) {
+  if (auto it = ranges::lower_bound(TILES_PERMUTATIONS, string_view{tile},
+                                    ranges::less{}, show_tile);
+      it != TILES_PERMUTATIONS.end() && show_tile(*it) == tile) {
     return static_cast<int>(distance(TILES_PERMUTATIONS.begin(), it));
   }
   return -1;
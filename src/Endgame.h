@@ -0,0 +1,272 @@
+#pragma once
+
+#include "AI.h"
+#include "Position.h"
+#include "TimeManagement.h"
+
+// Exact expectimax over the last placements of the game. Chance nodes draw
+// each of the 720 tiles uniformly and are pruned with Star1/Star2.
+namespace endgame {
+
+// The solver takes over from the tree search when the root has at most
+// MAX_MOVES legal moves and the game ends within MAX_PLIES placements.
+constexpr size_t MAX_MOVES{12};
+constexpr int MAX_PLIES{3};
+
+// No color scores more than all the squares of the board, which bounds every
+// expected score for the chance node pruning.
+constexpr double MAX_SCORE = []() {
+  double score{0.0};
+  for (int b = 1; b < ROWS; ++b) {
+    score += b * (ROWS - b) * (COLS - b);
+  }
+  return score;
+}();
+
+enum class Bound : uint8_t { EXACT, LOWER, UPPER };
+
+struct Entry {
+  double value;
+  Bound bound;
+};
+
+struct IdentityHash {
+  size_t operator()(uint64_t hash) const { return hash; }
+};
+
+// Whether every legal move at `pos` ends the game.
+inline bool last_ply(const Position& pos,
+                     const vector<const TileInfo*>& moves) {
+  return ranges::all_of(
+      moves, [&pos](auto tile_info) { return pos.ends_game_after(tile_info); });
+}
+
+// Exact expected score of `color` at `pos`, right after a placement, when
+// the next placement is the last one of the game: for each of the 720 tiles
+// the player to move takes their best placement.
+inline double last_ply_score(const Position& pos,
+                             const vector<const TileInfo*>& moves, Color color,
+                             const ColorWeights& weights, bool maximize) {
+  constexpr int N{TILES_PERMUTATIONS_COUNT};
+  array<float, N> best;
+  array<float, N> scores;
+  best.fill(maximize ? numeric_limits<float>::lowest()
+                     : numeric_limits<float>::max());
+  for (auto tile_info : moves) {
+    pos.get_placement_scores(tile_info, color, weights, scores);
+    for (int p = 0; p < N; ++p) {
+      best[p] = maximize ? max(best[p], scores[p]) : min(best[p], scores[p]);
+    }
+  }
+  double sum{0.0};
+  for (auto b : best) sum += b;
+  return sum / N;
+}
+
+// Values are expected scores of `color`, maximized when `root_player` is to
+// move and minimized otherwise.
+struct Solver {
+  const ColorWeights& weights;
+  Color color;
+  Player root_player;
+  double max_time;
+  decltype(get_time_point()) start;
+  atomic<bool>& aborted;
+  HashMap<uint64_t, Entry, IdentityHash, std::equal_to<uint64_t>> tt;
+  size_t nodes{0};
+
+  Solver(const ColorWeights& weights, Color color, Player root_player,
+         double max_time, atomic<bool>& aborted)
+      : weights(weights),
+        color(color),
+        root_player(root_player),
+        max_time(max_time),
+        start(get_time_point()),
+        aborted(aborted) {}
+
+  bool out_of_time() {
+    if ((++nodes & 1023) == 0 && get_delta_time_since(start) > max_time) {
+      aborted = true;
+    }
+    return aborted;
+  }
+
+  // `pos` has its tile, `moves` are its legal moves (never empty).
+  // With `probe` only the first move is searched, which bounds the value
+  // from one side.
+  double decision(const Position& pos, const vector<const TileInfo*>& moves,
+                  int plies, double alpha, double beta, bool probe = false) {
+    if (out_of_time()) return 0.0;
+
+    const auto key = pos.get_hash();
+    if (!probe) {
+      if (auto it = tt.find(key); it != tt.end()) {
+        const auto& [value, bound] = it->second;
+        if (bound == Bound::EXACT ||
+            (bound == Bound::LOWER && value >= beta) ||
+            (bound == Bound::UPPER && value <= alpha)) {
+          return value;
+        }
+      }
+    }
+
+    const bool maximize = pos.player == root_player;
+    double best = maximize ? -MAX_SCORE : MAX_SCORE;
+    auto a = alpha;
+    auto b = beta;
+    for (auto tile_info : moves) {
+      auto next = pos;
+      next.do_move(tile_info);
+      auto value = chance(next, plies - 1, a, b);
+      if (aborted) return 0.0;
+      if (maximize) {
+        best = max(best, value);
+        a = max(a, value);
+      } else {
+        best = min(best, value);
+        b = min(b, value);
+      }
+      if (probe || a >= b) break;
+    }
+
+    if (!probe) {
+      auto bound = best <= alpha  ? Bound::UPPER
+                   : best >= beta ? Bound::LOWER
+                                  : Bound::EXACT;
+      tt[key] = {best, bound};
+    }
+    return best;
+  }
+
+  // `pos` right after a placement, before its tile is drawn
+  double chance(const Position& pos, int plies, double alpha, double beta) {
+    auto next = pos;
+    const auto moves = next.get_possible_tiles();
+    if (moves.empty()) {
+      return next.get_expected_score(color, weights);
+    }
+    const bool maximize = next.player == root_player;
+    if (last_ply(next, moves)) {
+      return last_ply_score(next, moves, color, weights, maximize);
+    }
+    if (plies <= 1) {
+      // the game goes on past the horizon, the result would not be exact
+      aborted = true;
+      return 0.0;
+    }
+
+    constexpr int N{TILES_PERMUTATIONS_COUNT};
+    // Star2: one move per tile bounds each outcome from the side of the
+    // player to move there
+    array<double, N> lower;
+    array<double, N> upper;
+    lower.fill(-MAX_SCORE);
+    upper.fill(MAX_SCORE);
+    double probed_sum{0.0};
+    for (int t = 0; t < N; ++t) {
+      next.update_tile_index(t);
+      auto value = decision(next, moves, plies, -MAX_SCORE, MAX_SCORE, true);
+      if (aborted) return 0.0;
+      (maximize ? lower[t] : upper[t]) = value;
+      probed_sum += value;
+    }
+    if (maximize && probed_sum >= N * beta) return probed_sum / N;
+    if (!maximize && probed_sum <= N * alpha) return probed_sum / N;
+
+    // Star1: sum of the searched outcomes and bounds of the remaining ones
+    double sum{0.0};
+    double remaining_lower{0.0};
+    double remaining_upper{0.0};
+    for (int t = 0; t < N; ++t) {
+      remaining_lower += lower[t];
+      remaining_upper += upper[t];
+    }
+    for (int t = 0; t < N; ++t) {
+      remaining_lower -= lower[t];
+      remaining_upper -= upper[t];
+      auto child_alpha = N * alpha - sum - remaining_upper;
+      auto child_beta = N * beta - sum - remaining_lower;
+      double value;
+      if (upper[t] <= child_alpha) {
+        value = upper[t];
+      } else if (lower[t] >= child_beta) {
+        value = lower[t];
+      } else {
+        next.update_tile_index(t);
+        value = decision(next, moves, plies, max(child_alpha, lower[t]),
+                         min(child_beta, upper[t]));
+        if (aborted) return 0.0;
+        // a fail-soft result beyond a probe bound is the bound itself
+        value = std::clamp(value, lower[t], upper[t]);
+      }
+      sum += value;
+      if (sum + remaining_upper <= N * alpha) {
+        return (sum + remaining_upper) / N;
+      }
+      if (sum + remaining_lower >= N * beta) {
+        return (sum + remaining_lower) / N;
+      }
+    }
+    return sum / N;
+  }
+};
+
+// Optimal move at `pos` if the game provably ends within MAX_PLIES and the
+// solver finishes within `max_time` seconds. Root moves are split over
+// ctx.endgame_threads threads, sharing the best value found so far as the
+// alpha bound.
+inline optional<PlayerMove> solve(const Position& pos, AiContext& ctx,
+                                  double max_time) {
+  auto root = pos;
+  const auto moves = root.get_possible_tiles();
+  if (moves.empty() || moves.size() > MAX_MOVES) return nullopt;
+
+  auto start = get_time_point();
+  atomic<bool> aborted{false};
+  atomic<size_t> next_move{0};
+  atomic<size_t> nodes{0};
+  mutex best_mutex;
+  double best_value{-MAX_SCORE};
+  const TileInfo* best_tile_info{nullptr};
+
+  auto worker = [&]() {
+    Solver solver{ctx.weights, ctx.color, root.player, max_time, aborted};
+    for (auto i = next_move++; i < moves.size() && !aborted; i = next_move++) {
+      double alpha;
+      {
+        lock_guard lock(best_mutex);
+        alpha = best_value;
+      }
+      auto next = root;
+      next.do_move(moves[i]);
+      auto value = solver.chance(next, MAX_PLIES - 1, alpha, MAX_SCORE);
+      if (aborted) break;
+      lock_guard lock(best_mutex);
+      if (!best_tile_info || value > best_value) {
+        best_value = value;
+        best_tile_info = moves[i];
+      }
+    }
+    nodes += solver.nodes;
+  };
+
+  const unsigned threads = ctx.endgame_threads > 0
+                              ? static_cast<unsigned>(ctx.endgame_threads)
+                              : thread::hardware_concurrency();
+  auto threads_count = min<size_t>(max(threads, 1u), moves.size());
+  vector<thread> workers;
+  for (size_t i = 1; i < threads_count; ++i) workers.emplace_back(worker);
+  worker();
+  for (auto& w : workers) w.join();
+
+  auto dt = get_delta_time_since(start);
+  if (aborted || !best_tile_info) {
+    ctx.log << "endgame unsolved dt=" << dt << endl;
+    return nullopt;
+  }
+  ctx.log << "endgame solved v=" << best_value << " c=" << moves.size()
+          << " n=" << nodes << " dt=" << dt << endl;
+  return best_tile_info->move();
+}
+
+}  // namespace endgame
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Position.h"
+
+// A position as one line of text: the game that leads to it, in the records
+// of the CodeCup protocol, and the tile to place.
+//
+//   <color> <start-tile> [<dot><tile><orientation> ...] <tile>
+//
+// For example `3 Hh123456h Fi654321v 415263` is the position where the
+// player of color 3 places tile 415263 after one move.
+namespace game_record {
+
+inline bool valid_tile(string_view s) {
+  return s.size() == TILE_DOTS &&
+         ranges::is_permutation(s, string_view{"123456"});
+}
+
+inline bool valid_dot(string_view s) {
+  return s[0] >= 'A' && s[0] < 'A' + ROWS && s[1] >= 'a' && s[1] < 'a' + COLS;
+}
+
+inline vector<string_view> split_words(string_view line) {
+  vector<string_view> words;
+  while (!line.empty()) {
+    auto begin = line.find_first_not_of(" \t\r");
+    if (begin == string_view::npos) break;
+    auto end = line.find_first_of(" \t\r", begin);
+    if (end == string_view::npos) end = line.size();
+    words.push_back(line.substr(begin, end - begin));
+    line.remove_prefix(end);
+  }
+  return words;
+}
+
+struct PositionRecord {
+  Color color;
+  Position pos;
+};
+
+// The position of a line with its tile drawn, nullopt if the line is not a
+// legal game.
+inline optional<PositionRecord> parse_position(string_view line) {
+  auto words = split_words(line);
+  if (words.size() < 3) return nullopt;
+  const auto& color = words[0];
+  if (color.size() != 1 || color[0] < '1' || color[0] >= '1' + MAX_COLORS) {
+    return nullopt;
+  }
+  const auto& start = words[1];
+  if (start.size() != 9 || !valid_dot(start) ||
+      !valid_tile(start.substr(2, TILE_DOTS)) ||
+      (start[8] != VERTICAL && start[8] != HORIZONTAL)) {
+    return nullopt;
+  }
+  PositionRecord res{color[0], Position{string{start}}};
+  auto& pos = res.pos;
+  for (size_t i = 2; i + 1 < words.size(); ++i) {
+    const auto& record = words[i];
+    if (record.size() != 9 || !valid_dot(record) ||
+        !valid_tile(record.substr(2, TILE_DOTS)) ||
+        (record[8] != VERTICAL && record[8] != HORIZONTAL)) {
+      return nullopt;
+    }
+    const auto [tile, move] = parse_moves(string{record});
+    if (pos.end_game()) return nullopt;
+    pos.do_move(tile);
+    if (!pos.possible_move(move.dot, move.orientation)) return nullopt;
+    pos.do_move(move);
+  }
+  const auto& tile = words.back();
+  if (!valid_tile(tile) || pos.end_game()) return nullopt;
+  pos.do_move(ChanceMove{tile});
+  return res;
+}
+
+}  // namespace game_record
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "GameRecord.h"
+#include "MctsAi.h"
+
+// One game of the player in the CodeCup line protocol, read a word at a
+// time: its color, the starting tile, then for every move "Start" or the
+// record of the opponent's move, and the tile to place, answered by the
+// placement, until "Quit". It holds the position, the opponent weights and
+// the time used by the game.
+class GameSession {
+ public:
+  // what a word leaves the session waiting for
+  enum class Step { READ, MOVE, QUIT, ERROR };
+
+  // shared by the sessions of a process
+  struct Settings {
+    int leaf_rollouts{1};
+    int halving_turn{numeric_limits<int>::max()};
+    int endgame_threads{0};
+    const opening_book::Book* book{nullptr};
+    telemetry::Sink* telemetry{nullptr};
+  };
+
+  GameSession(ostream& log, const Settings& settings)
+      : log(log), settings(settings) {}
+
+  Step read(const string& word) {
+    switch (expected) {
+      case Expected::COLOR:
+        if (word.size() != 1 || word[0] < '1' ||
+            word[0] >= '1' + MAX_COLORS) {
+          return Step::ERROR;
+        }
+        log << "my-color=" << word << endl;
+        ctx = make_unique<AiContext>(word[0], log);
+        ctx->leaf_rollouts = settings.leaf_rollouts;
+        ctx->halving_turn = settings.halving_turn;
+        ctx->endgame_threads = settings.endgame_threads;
+        ctx->book = settings.book;
+        ctx->telemetry = settings.telemetry;
+        expected = Expected::START_TILE;
+        return Step::READ;
+      case Expected::START_TILE:
+        if (!valid_record(word)) return Step::ERROR;
+        log << "starting-tile=" << word << endl;
+        pos.emplace(word);
+        expected = Expected::RECORD;
+        return Step::READ;
+      case Expected::RECORD:
+        if (word == "Quit") return Step::QUIT;
+        if (word != "Start" && !play_opponent_move(word)) return Step::ERROR;
+        expected = Expected::TILE;
+        return Step::READ;
+      case Expected::TILE:
+        if (!game_record::valid_tile(word) || pos->end_game()) {
+          return Step::ERROR;
+        }
+        log << word << endl;
+        pos->do_move(ChanceMove{word});
+        expected = Expected::RECORD;
+        return Step::MOVE;
+    }
+    return Step::ERROR;
+  }
+
+  // Searches and plays the placement of the tile read last, after `waited`
+  // seconds spent since the tile arrived, which count as used.
+  string move(double waited = 0.0) {
+    ctx->total_time += waited;
+    const auto my_move = mcts_ai::get_best_move(*pos, *ctx);
+    pos->do_move(my_move);
+    ++moves;
+    return my_move.show();
+  }
+
+  int moves_count() const { return moves; }
+  double total_time() const { return ctx ? ctx->total_time : 0.0; }
+
+ private:
+  enum class Expected { COLOR, START_TILE, RECORD, TILE };
+
+  static bool valid_record(const string& word) {
+    return word.size() == 9 && game_record::valid_dot(word) &&
+           game_record::valid_tile(word.substr(2, TILE_DOTS)) &&
+           (word[8] == VERTICAL || word[8] == HORIZONTAL);
+  }
+
+  bool play_opponent_move(const string& word) {
+    if (!valid_record(word) || pos->end_game()) return false;
+    log << word << endl;
+    const auto [chance_move, opponent_move] = parse_moves(word);
+    pos->do_move(chance_move);
+    if (!pos->possible_move(opponent_move.dot, opponent_move.orientation)) {
+      return false;
+    }
+    auto delta_evals = pos->get_delta_evals(opponent_move);
+    for (int i = 0; i < MAX_COLORS; ++i) {
+      total_delta_evals[i] += delta_evals[i];
+    }
+    ctx->weights.update_weigths(total_delta_evals, ctx->color, ctx->log);
+    pos->do_move(opponent_move);
+    return true;
+  }
+
+  ostream& log;
+  const Settings& settings;
+  Expected expected{Expected::COLOR};
+  // created with the color, which it cannot change
+  unique_ptr<AiContext> ctx;
+  optional<Position> pos;
+  array<double, MAX_COLORS> total_delta_evals{};
+  int moves{0};
+};
+
+// The resources and settings of the player from its environment:
+// BOX_LEAF_ROLLOUTS, BOX_HALVING_TURN, the opening book in BOX_BOOK
+// (default box.book, see book.cc) and the telemetry file in BOX_TELEMETRY
+// (see Telemetry.h).
+struct PlayerEnvironment {
+  opening_book::Book book;
+  unique_ptr<telemetry::Sink> telemetry;
+  GameSession::Settings settings;
+
+  explicit PlayerEnvironment(ostream& log) : book(book_path()) {
+    if (auto leaf_rollouts = getenv("BOX_LEAF_ROLLOUTS")) {
+      settings.leaf_rollouts = std::atoi(leaf_rollouts);
+    }
+    if (auto halving_turn = getenv("BOX_HALVING_TURN")) {
+      settings.halving_turn = std::atoi(halving_turn);
+    }
+    if (!book.empty()) {
+      log << "book-entries=" << book.count() << endl;
+      settings.book = &book;
+    }
+    if (auto telemetry_path = getenv("BOX_TELEMETRY")) {
+      telemetry = make_unique<telemetry::Sink>(telemetry_path);
+      if (telemetry->is_open()) {
+        settings.telemetry = telemetry.get();
+      } else {
+        log << "cannot open " << telemetry_path << endl;
+      }
+    }
+  }
+
+  static string book_path() {
+    auto path = getenv("BOX_BOOK");
+    return path ? path : "box.book";
+  }
+};
@@ -1,13 +1,23 @@
 #pragma once
 
 #include "AI.h"
+#include "Endgame.h"
+#include "MctsPolicies.h"
+#include "OpeningBook.h"
 #include "Position.h"
+#include "Profile.h"
 #include "RNG.h"
+#include "Telemetry.h"
 #include "TimeManagement.h"
 
 namespace mcts_ai {
 
-constexpr bool USE_DOT_COLOR_STATS{true};
+// Positions with at most this many candidates are checked for a last ply,
+// which is then scored exactly instead of by a random rollout
+constexpr size_t LAST_PLY_CANDIDATES{64};
+constexpr int MAX_LEAF_ROLLOUTS{64};
+// children of the root the sequential halving starts from
+constexpr int HALVING_CANDIDATES{16};
 
 struct DotColorStats {
   static constexpr int MAX{TOTAL_DOTS * MAX_COLORS};
@@ -22,13 +32,15 @@ struct DotColorStats {
     stats[code(dot, color)].update(v);
   }
 
-  double evaluate(const Position& pos, const TileInfo* tile_info) const {
+  // `pos` is the mirror image `symmetry` of a position of the game
+  double evaluate(const Position& pos, const TileInfo* tile_info,
+                  int symmetry = IDENTITY) const {
     double sum{0.0};
 
     for (int i{0}; const auto& [d1, d2] : tile_info->siblings) {
-      auto color = pos.tile[i++];
+      auto color = pos.tile_color(i++);
       for (int dot : {d1, d2}) {
-        sum += stats[code(dot, color)].value;
+        sum += stats[code(mirror_dot(dot, symmetry), color)].value;
       }
     }
     double eval = sum / 12.0;
@@ -43,12 +55,11 @@ struct DotColorStats {
   }
 };
 
-DotColorStats dot_color_stats;
-
+template <class P = DefaultPolicies>
 struct ActionInfo {
   explicit ActionInfo(const TileInfo* info) : tile_info(info) {}
 
-  static constexpr double K0{10.0};
+  static constexpr double K0{P::Selection::K0};
   static constexpr double K0xK0{K0 * K0};
 
   const TileInfo* tile_info;
@@ -57,6 +68,8 @@ struct ActionInfo {
   double K{K0};
   double bias{0.0};
   int visits{0};
+  // all-moves-as-first statistics, see Rave
+  Stats amaf;
 
   void update(double v) {
     visits += 1;
@@ -67,43 +80,50 @@ struct ActionInfo {
   }
 };
 
-const vector<double> BONUS = []() {
-  vector<double> res;
-  for (int v = 0; v < 200'000; ++v) {
-    res.push_back(sqrt(log(1 + v)));
-  }
-  return res;
-}();
-
-const vector<double> SQRT = []() {
-  vector<double> res;
-  for (int v = 0; v < 200'000; ++v) {
-    res.push_back(sqrt(v));
-  }
-  return res;
-}();
-
+template <class P = DefaultPolicies>
 struct StateInfo {
+  using Action = ActionInfo<P>;
+
+  // listed by the first expansion, see widen()
   TileSet unexpanded_tiles;
-  vector<ActionInfo> actions;
-  double bonus{0.0};
+  vector<Action> actions;
   int visits{0};
   Player player;
 
-  explicit StateInfo(const Position& pos)
-      : unexpanded_tiles(pos.get_possible_tiles_set()), player(pos.player) {}
+  explicit StateInfo(const Position& pos) : player(pos.player) {}
+
+  // Lists the placements to expand. The legal placements do not depend on
+  // the tile, so the node of a tile takes those of the node shared by all
+  // the tiles, which was expanded first.
+  void widen(const Position& pos, const StateInfo* shared) {
+    if (shared && shared != this && !shared->actions.empty()) {
+      unexpanded_tiles = shared->unexpanded_tiles;
+      for (const auto& action_info : shared->actions) {
+        unexpanded_tiles.set(action_info.tile_info->code);
+      }
+      return;
+    }
+    unexpanded_tiles = placements(pos);
+  }
 
-  double eval(const Position& pos, const ActionInfo* action_info) const {
-    auto e = action_info->value +
-             action_info->K * bonus / SQRT[1 + action_info->visits];
-    if constexpr (USE_DOT_COLOR_STATS) {
-      e += action_info->bias / (1 + action_info->visits);
+  // The legal placements at `pos`. A placement and its mirror image are the
+  // same move when the position is its own mirror image, only one of them
+  // is searched.
+  static TileSet placements(const Position& pos) {
+    auto res = pos.get_possible_tiles_set();
+    for (int symmetry = 1; symmetry < SYMMETRIES; ++symmetry) {
+      if (!pos.symmetric(symmetry)) continue;
+      res.for_each([&](auto tile_info) {
+        if (TILES_MIRROR_CODES[symmetry][tile_info->code] < tile_info->code) {
+          res.clear(tile_info->code);
+        }
+      });
     }
-    return e;
+    return res;
   }
 
-  ActionInfo* select_most_visited() {
-    ActionInfo* most_visited{nullptr};
+  Action* select_most_visited() {
+    Action* most_visited{nullptr};
     int max_visits{numeric_limits<int>::lowest()};
     for (auto& action_info : actions) {
       if (max_visits < action_info.visits) {
@@ -114,14 +134,43 @@ struct StateInfo {
     return most_visited;
   }
 
-  ActionInfo* select(const Position& pos) {
-    auto expanded_limit = static_cast<size_t>(SQRT[visits + 1]);
-    if (expanded_limit > 64) expanded_limit = 64;
-    while (actions.size() < expanded_limit && unexpanded_tiles.any()) {
+  // weight, in visits, of the dot color estimate of an unexpanded tile
+  // against what its placement scored with the other tiles
+  static constexpr int PRIOR_VISITS{4};
+
+  Action* find(const TileInfo* tile_info) {
+    auto it = ranges::find(actions, tile_info, &Action::tile_info);
+    return it != actions.end() ? &*it : nullptr;
+  }
+
+  const Action* find(const TileInfo* tile_info) const {
+    return const_cast<StateInfo*>(this)->find(tile_info);
+  }
+
+  // `shared` holds the statistics of the placements over all the tiles
+  Action* select(const Position& pos, const DotColorStats& dot_color_stats,
+                 int symmetry, const StateInfo* shared = nullptr) {
+    expand(pos, dot_color_stats, symmetry, shared,
+           P::Expansion::limit(visits));
+    return select_best();
+  }
+
+  // Expands the unexpanded placements of best prior until there are
+  // `limit` children.
+  void expand(const Position& pos, const DotColorStats& dot_color_stats,
+              int symmetry, const StateInfo* shared, size_t limit) {
+    profile::Scope expansion{profile::EXPANSION};
+    // a position that is not the end of the game has a legal placement
+    if (actions.empty()) widen(pos, shared);
+    while (actions.size() < limit && unexpanded_tiles.any()) {
       const TileInfo* selected{nullptr};
       auto best_value = numeric_limits<double>::lowest();
-      unexpanded_tiles.for_each([&pos, &best_value, &selected](auto tile_info) {
-        auto value = dot_color_stats.evaluate(pos, tile_info);
+      unexpanded_tiles.for_each([&](auto tile_info) {
+        auto value = dot_color_stats.evaluate(pos, tile_info, symmetry);
+        if (auto stats = shared ? shared->find(tile_info) : nullptr) {
+          value = (stats->visits * stats->value + PRIOR_VISITS * value) /
+                  (stats->visits + PRIOR_VISITS);
+        }
         if (best_value < value) {
           best_value = value;
           selected = tile_info;
@@ -131,11 +180,16 @@ struct StateInfo {
       actions.back().bias = best_value;
       unexpanded_tiles.clear(selected->code);
     }
+  }
 
-    ActionInfo* best_action{nullptr};
+  Action* select_best() {
+    profile::Scope selection{profile::SELECTION};
+    Action* best_action{nullptr};
     double best_value{numeric_limits<double>::lowest()};
+    const double bonus = bonus_of(visits);
     for (auto& action_info : actions) {
-      if (auto value = eval(pos, &action_info); best_value < value) {
+      if (auto value = P::Selection::eval(action_info, bonus);
+          best_value < value) {
         best_value = value;
         best_action = &action_info;
       }
@@ -143,18 +197,110 @@ struct StateInfo {
     return best_action;
   }
 
-  void update(ActionInfo* action_info, double score) {
+  // the dot color bias depends on the tile, which changes from one visit
+  // of a node shared by all the tiles to the next
+  void update_bias(const Position& pos, const DotColorStats& dot_color_stats,
+                   int symmetry) {
+    profile::Scope selection{profile::SELECTION};
+    for (auto& action_info : actions) {
+      action_info.bias =
+          dot_color_stats.evaluate(pos, action_info.tile_info, symmetry);
+    }
+  }
+
+  void update(Action* action_info, double score) {
     ++visits;
     action_info->update(score);
-    bonus = BONUS[visits];
   }
 
-  bool consistent(const Position& pos) {
-    return select_most_visited() == select(pos);
+  bool consistent(const Position& pos, const DotColorStats& dot_color_stats,
+                  int symmetry) {
+    return select_most_visited() == select(pos, dot_color_stats, symmetry);
   }
+
+  size_t memory() const {
+    return sizeof(StateInfo) + actions.capacity() * sizeof(Action);
+  }
+};
+
+// A placement from the node of a tile, the tile by its index.
+struct Edge {
+  const void* afterstate{nullptr};
+  int tile_index{-1};
+  int code{-1};
+
+  bool operator==(const Edge&) const = default;
 };
 
+// A position right after a placement, before its tile is drawn. The legal
+// placements do not depend on the tile, so a single node shared by all the
+// tiles holds their statistics. A node of its own is only created for a
+// tile drawn a second time, the 720 tiles would split the visits otherwise.
+template <class P = DefaultPolicies>
+struct AfterStateInfo {
+  using State = StateInfo<P>;
+  using StateEntry = pair<int, unique_ptr<State>>;
+
+  unique_ptr<State> shared;
+  // drawn tiles by index, with a node if drawn more than once
+  vector<StateEntry> states;
+  // the edge that created the node, a transposition reaches it by another
+  Edge parent;
+  bool transposed{false};
+
+  State* get_state(int tile_index) const {
+    auto it = ranges::lower_bound(states, tile_index, {}, &StateEntry::first);
+    return it != states.end() && it->first == tile_index ? it->second.get()
+                                                         : nullptr;
+  }
+
+  // node to select the placement from at `pos`
+  State* try_create_state(const Position& pos) {
+    auto it =
+        ranges::lower_bound(states, pos.tile_index, {}, &StateEntry::first);
+    if (it != states.end() && it->first == pos.tile_index) {
+      if (!it->second) it->second = make_unique<State>(pos);
+      return it->second.get();
+    }
+    states.emplace(it, pos.tile_index, nullptr);
+    if (!shared) {
+      shared = make_unique<State>(pos);
+    }
+    return shared.get();
+  }
+
+  // a placement made from the node of a tile also counts for all the tiles
+  void update_shared(const State* state_info,
+                     const typename State::Action* action_info, double score) {
+    if (shared && state_info != shared.get()) {
+      if (auto shared_action = shared->find(action_info->tile_info)) {
+        shared->update(shared_action, score);
+      }
+    }
+  }
+
+  size_t states_count() const {
+    return ranges::count_if(states, [](const auto& entry) {
+      return entry.second != nullptr;
+    }) + (shared ? 1 : 0);
+  }
+
+  size_t memory() const {
+    auto res = sizeof(AfterStateInfo) + states.capacity() * sizeof(StateEntry);
+    if (shared) res += shared->memory();
+    for (const auto& [_, state_info] : states) {
+      if (state_info) res += state_info->memory();
+    }
+    return res;
+  }
+};
+
+template <class P = DefaultPolicies>
 struct StateStore {
+  using AfterState = AfterStateInfo<P>;
+  using State = StateInfo<P>;
+  using Action = ActionInfo<P>;
+
   struct PositionInfoHash {
     size_t operator()(const Position::Info& info) const { return info.hash; }
   };
@@ -167,20 +313,42 @@ struct StateStore {
     }
   };
 
-  HashMap<Position::Info, StateInfo, PositionInfoHash, PositionInfoEqual> Q;
+  // keyed by the afterstate info, which has no tile
+  HashMap<Position::Info, AfterState, PositionInfoHash, PositionInfoEqual> Q;
 
-  pair<StateInfo*, bool> try_create_state(const Position& pos) {
-    auto [it, inserted] = Q.try_emplace(pos.get_info(), pos);
+  pair<AfterState*, bool> try_create_afterstate(const Position& pos) {
+    profile::count(profile::HASH_PROBES);
+    auto [it, inserted] = Q.try_emplace(pos.get_afterstate_info());
     return {&it->second, inserted};
   }
 
-  StateInfo* get(const Position& pos) {
-    auto it = Q.find(pos.get_info());
+  AfterState* get_afterstate(const Position& pos) {
+    profile::count(profile::HASH_PROBES);
+    auto it = Q.find(pos.get_afterstate_info());
     return it != Q.end() ? &it->second : nullptr;
   }
 
+  State* get(const Position& pos) {
+    auto afterstate = get_afterstate(pos);
+    return afterstate ? afterstate->get_state(pos.tile_index) : nullptr;
+  }
+
   void prepare_for(auto size) { Q.reserve(size); }
 
+  size_t states_count() const {
+    size_t res{0};
+    for (const auto& [_, afterstate] : Q) res += afterstate.states_count();
+    return res;
+  }
+
+  size_t memory() const {
+    size_t res{Q.bucket_count() * sizeof(void*)};
+    for (const auto& [_, afterstate] : Q) {
+      res += sizeof(Position::Info) + afterstate.memory();
+    }
+    return res;
+  }
+
   void print_stats(ostream& out) const {
     map<size_t, size_t> m;
     size_t total{0};
@@ -195,15 +363,20 @@ struct StateStore {
           << " ";
     }
     out << "total:" << total << "}" << endl;
-    const ActionInfo* lowest_variance_action{nullptr};
-    const ActionInfo* highest_variance_action{nullptr};
-    for (const auto& [k, v] : Q) {
-      for (const auto& action : v.actions) {
-        if (!lowest_variance_action || lowest_variance_action->K > action.K) {
-          lowest_variance_action = &action;
-        }
-        if (!highest_variance_action || highest_variance_action->K < action.K) {
-          highest_variance_action = &action;
+    const Action* lowest_variance_action{nullptr};
+    const Action* highest_variance_action{nullptr};
+    for (const auto& [k, afterstate] : Q) {
+      for (const auto& [_, v] : afterstate.states) {
+        if (!v) continue;
+        for (const auto& action : v->actions) {
+          if (!lowest_variance_action ||
+              lowest_variance_action->K > action.K) {
+            lowest_variance_action = &action;
+          }
+          if (!highest_variance_action ||
+              highest_variance_action->K < action.K) {
+            highest_variance_action = &action;
+          }
         }
       }
     }
@@ -218,85 +391,234 @@ struct StateStore {
   }
 };
 
+// Mutable state of one search. Concurrent searches each own one, while the
+// tile tables, Zobrist keys and the BONUS/SQRT tables are shared read-only.
+template <class P = DefaultPolicies>
+struct SearchContext {
+  StateStore<P> state_store;
+  DotColorStats dot_color_stats;
+  FastRandom rng;
+  const ColorWeights& weights;
+  Color color;
+  size_t max_level{0};
+  // rollouts played from each leaf, backed up once as their mean
+  int leaf_rollouts;
+  size_t rollouts{0};
+  // positions of the extra rollouts, kept to reuse their memory
+  vector<Position> rollout_positions;
+  typename P::Rollout::Tables rollout_tables;
+  // one per rollout from a leaf
+  vector<typename P::Rollout::State> rollout_states;
+  // steps of the tree descents and those into a node reached by more than
+  // one edge, and the number of such nodes
+  size_t tree_steps{0};
+  size_t transposition_hits{0};
+  size_t transpositions{0};
+
+  SearchContext(const ColorWeights& weights, Color color, uint32_t seed,
+                int leaf_rollouts = 1)
+      : rng(seed),
+        weights(weights),
+        color(color),
+        leaf_rollouts(std::clamp(leaf_rollouts, 1, MAX_LEAF_ROLLOUTS)) {}
+};
+
+template <class P = DefaultPolicies>
 struct Warmup {
+  SearchContext<P>& search;
   Position pos;
   Player player;
-  Color color;
 
-  explicit Warmup(const Position& p, Color c)
-      : pos(p), player(p.player), color(c) {}
+  explicit Warmup(SearchContext<P>& search, const Position& p)
+      : search(search), pos(p), player(p.player) {}
 
   void run() {
-    while (auto tile_info = pos.get_random_move()) {
+    while (auto tile_info = pos.get_random_move(search.rng)) {
       pos.do_move(tile_info);
-      pos.play_chance_move();
-    }
-    auto score = pos.get_expected_score(color);
-    for (int dot : ALL_DOTS) {
-      if (auto dot_color = pos.colors[dot]; dot_color != Position::WHITE) {
-        dot_color_stats.update(dot, dot_color, player, score);
-      }
+      pos.play_chance_move(search.rng);
     }
+    auto score = pos.get_expected_score(search.color, search.weights);
+    pos.for_each_colored_dot([&](int dot, Color dot_color) {
+      search.dot_color_stats.update(dot, dot_color, player, score);
+    });
   }
 };
 
+template <class P = DefaultPolicies>
 struct Simulation {
-  StateStore& state_store;
+  using AfterState = AfterStateInfo<P>;
+  using State = StateInfo<P>;
+  using Action = ActionInfo<P>;
+
+  SearchContext<P>& search;
   Position pos;
   Player player;
-  vector<tuple<StateInfo*, ActionInfo*>> transitions{};
-  Color color;
+  // with the symmetry of the position at each step
+  vector<tuple<AfterState*, State*, Action*, int>> transitions{};
+  optional<double> exact_score;
+  // `pos` is this mirror image of the position of the game
+  int symmetry;
+  // placements of the rollouts by each player, in the frame of the game
+  array<TileSet, 2> played{};
+  // played at the first node instead of the selection, if set
+  Action* first_action{nullptr};
+  // the last edge of the descent
+  Edge edge;
 
-  static inline size_t max_level{0};
+  Simulation(SearchContext<P>& search, const Position& p, int symmetry)
+      : search(search), pos(p), player(p.player), symmetry(symmetry) {}
 
-  static void reset_stats() {
-    max_level = 0;
-    if constexpr (USE_DOT_COLOR_STATS) {
-      dot_color_stats.reset();
-    }
+  void add(AfterState* afterstate, State* state_info, Action* action_info) {
+    transitions.emplace_back(afterstate, state_info, action_info, symmetry);
   }
 
-  Simulation(StateStore& state_store, const Position& p, Color color)
-      : state_store(state_store), pos(p), player(p.player), color(color) {}
-
-  void add(StateInfo* state_info, ActionInfo* action_info) {
-    transitions.emplace_back(state_info, action_info);
+  // Expected score over all the tiles when the next placement is the last
+  // one of the game, which removes the noise of the last chance move.
+  bool score_last_ply() {
+    if (pos.candidates.size() > LAST_PLY_CANDIDATES) return false;
+    profile::Scope scoring{profile::SCORING};
+    auto p = pos;
+    auto moves = p.get_possible_tiles();
+    if (moves.empty() || !endgame::last_ply(p, moves)) return false;
+    exact_score = endgame::last_ply_score(p, moves, search.color,
+                                          search.weights, p.player == player);
+    return true;
   }
 
-  void next(StateInfo* state_info) {
-    auto action_info = state_info->select(pos);
-    pos.do_move(action_info->tile_info);
-    pos.play_chance_move();
-    add(state_info, action_info);
+  void next(AfterState* afterstate, State* state_info) {
+    if constexpr (P::Selection::DOT_COLOR_STATS) {
+      if (state_info == afterstate->shared.get()) {
+        state_info->update_bias(pos, search.dot_color_stats, symmetry);
+      }
+    }
+    auto action_info =
+        first_action ? std::exchange(first_action, nullptr)
+                     : state_info->select(pos, search.dot_color_stats, symmetry,
+                                          afterstate->shared.get());
+    edge = {afterstate, pos.tile_index, action_info->tile_info->code};
+    {
+      profile::Scope tree_move{profile::TREE_MOVE};
+      pos.do_move(action_info->tile_info);
+    }
+    add(afterstate, state_info, action_info);
+    if (score_last_ply()) return;
+    profile::Scope tree_move{profile::TREE_MOVE};
+    pos.play_chance_move(search.rng);
   }
 
   void simulate_tree() {
-    while (!pos.end_game()) {
-      auto [state_info, created] = state_store.try_create_state(pos);
-      next(state_info);
+    while (!exact_score && !pos.end_game()) {
+      // the mirror images of a position share the node of the canonical one
+      auto canonical = pos.get_canonical_symmetry();
+      pos.mirror(canonical);
+      symmetry ^= canonical;
+      auto [afterstate, created] =
+          search.state_store.try_create_afterstate(pos);
+      reach(afterstate, created);
       if (created) {
         break;
       }
+      next(afterstate, afterstate->try_create_state(pos));
     }
   }
 
-  void simulate_default() {
-    while (auto tile_info = pos.get_random_move()) {
-      pos.do_move(tile_info);
-      pos.play_chance_move();
+  // A node reached by another edge than the one that created it is a
+  // transposition.
+  void reach(AfterState* afterstate, bool created) {
+    if (transitions.empty()) return;
+    ++search.tree_steps;
+    if (created) {
+      afterstate->parent = edge;
+    } else if (!afterstate->transposed && afterstate->parent != edge) {
+      afterstate->transposed = true;
+      ++search.transpositions;
     }
+    search.transposition_hits += afterstate->transposed;
   }
 
-  void backup() const {
-    auto score = pos.get_expected_score(color);
-    for (const auto& [state_info, action_info] : transitions) {
+  // Rollouts from the leaf, played a move at a time in turn so that the
+  // memory accesses of one overlap the work on the others. Returns the mean
+  // backed up value.
+  double simulate_default() {
+    profile::Scope rollout{profile::ROLLOUT};
+    auto& positions = search.rollout_positions;
+    positions.assign(search.leaf_rollouts - 1, pos);
+    search.rollout_states.resize(search.leaf_rollouts);
+    array<Position*, MAX_LEAF_ROLLOUTS> active;
+    array<typename P::Rollout::State*, MAX_LEAF_ROLLOUTS> states;
+    int count{0};
+    active[count++] = &pos;
+    for (auto& p : positions) active[count++] = &p;
+    const int rollouts = count;
+    for (int i = 0; i < rollouts; ++i) states[i] = &search.rollout_states[i];
+
+    double sum{0.0};
+    auto finish = [&](const Position& p) {
+      double value;
+      {
+        profile::Scope scoring{profile::SCORING};
+        value = P::Backup::value(
+            p.get_expected_score(search.color, search.weights));
+      }
+      update_dot_color_stats(p, value);
+      sum += value;
+    };
+    for (int ply = 0; count > 0; ++ply) {
+      for (int i = 0; i < count;) {
+        auto& p = *active[i];
+        if (auto tile_info = P::Rollout::next_move(p, ply, *this, *states[i])) {
+          if constexpr (P::Selection::AMAF) {
+            played[p.player - PLAYER_1].set(
+                TILES_MIRROR_CODES[symmetry][tile_info->code]);
+          }
+          p.do_move(tile_info);
+          p.play_chance_move(search.rng);
+          ++i;
+        } else {
+          finish(p);
+          --count;
+          active[i] = active[count];
+          states[i] = states[count];
+        }
+      }
+    }
+    search.rollouts += rollouts;
+    return sum / rollouts;
+  }
+
+  void update_dot_color_stats(const Position& p, double score) const {
+    if constexpr (P::Selection::DOT_COLOR_STATS) {
+      profile::Scope backup{profile::BACKUP};
+      p.for_each_colored_dot([&](int dot, Color dot_color) {
+        search.dot_color_stats.update(mirror_dot(dot, symmetry), dot_color,
+                                      player, score);
+      });
+    }
+  }
+
+  void backup(double score) {
+    profile::Scope backup{profile::BACKUP};
+    for (const auto& [afterstate, state_info, action_info, _] : transitions) {
       auto adjusted_score = state_info->player == player ? score : -score;
       state_info->update(action_info, adjusted_score);
+      afterstate->update_shared(state_info, action_info, adjusted_score);
     }
-    if constexpr (USE_DOT_COLOR_STATS) {
-      for (int dot : ALL_DOTS) {
-        if (auto dot_color = pos.colors[dot]; dot_color != Position::WHITE) {
-          dot_color_stats.update(dot, dot_color, player, score);
+    if constexpr (P::Selection::AMAF) backup_amaf(score);
+  }
+
+  // Every child of a node whose placement the player of the node made at
+  // that step or later gets the score, the last steps first so that
+  // `played` holds the later placements.
+  void backup_amaf(double score) {
+    for (auto it = transitions.rbegin(); it != transitions.rend(); ++it) {
+      const auto& [_, state_info, action_info, step_symmetry] = *it;
+      const auto& mirror_codes = TILES_MIRROR_CODES[step_symmetry];
+      auto& later = played[state_info->player - PLAYER_1];
+      later.set(mirror_codes[action_info->tile_info->code]);
+      auto adjusted_score = state_info->player == player ? score : -score;
+      for (auto& child : state_info->actions) {
+        if (later.test(mirror_codes[child.tile_info->code])) {
+          child.amaf.update(adjusted_score);
         }
       }
     }
@@ -304,13 +626,18 @@ struct Simulation {
 
   void run() {
     simulate_tree();
-    max_level = max(max_level, transitions.size());
-    simulate_default();
-    backup();
+    search.max_level = max(search.max_level, transitions.size());
+    if (exact_score) {
+      auto value = P::Backup::value(*exact_score);
+      update_dot_color_stats(pos, value);
+      backup(value);
+    } else {
+      backup(simulate_default());
+    }
   }
 };
 
-double get_max_time(const Position& pos, const AiContext& ctx) {
+inline double get_max_time(const Position& pos, const AiContext& ctx) {
 #ifdef BOX_SUBMISSION
   constexpr double ratio{1.0};
 #else
@@ -324,69 +651,406 @@ double get_max_time(const Position& pos, const AiContext& ctx) {
   return remaining_time / static_cast<double>(r);
 }
 
-PlayerMove get_best_move(const Position& pos, AiContext& ctx) {
-  Simulation::reset_stats();
+// Sends `record`, completed with what every move has, to the telemetry sink
+// of `ctx` if any.
+inline void report(const Position& pos, const AiContext& ctx, PlayerMove move,
+                   telemetry::MoveRecord record) {
+  if (!ctx.telemetry) return;
+  record.turn = pos.turn;
+  record.color = ctx.color;
+  record.weights = ctx.weights.weights;
+  record.move = move;
+  ctx.telemetry->submit(record);
+}
+
+struct SearchStats {
+  int simulations{0};
+  size_t rollouts{0};
+  size_t max_level{0};
+  double time{0.0};
+  size_t afterstates{0};
+  // see RootStats
+  size_t tree_steps{0};
+  size_t transposition_hits{0};
+  size_t transpositions{0};
+};
+
+// A root child, in the frame of the game.
+struct ChildStats {
+  const TileInfo* tile_info;
+  int visits;
+  double value;
+  double K;
+  double bias;
+};
+
+struct RootStats {
+  int simulations{0};
+  size_t rollouts{0};
+  size_t max_level{0};
+  int visits{0};
+  // the child of best_move() first, then most visited first
+  vector<ChildStats> children;
+  // the most visited child is the one the selection would pick
+  bool consistent{false};
+  size_t afterstates{0};
+  size_t buckets{0};
+  // steps of the tree descents, those into an afterstate reached by more
+  // than one edge, and the number of such afterstates
+  size_t tree_steps{0};
+  size_t transposition_hits{0};
+  size_t transpositions{0};
+};
+
+// An anytime search: the host runs it by slices of simulations or time,
+// reads its current best move and statistics in between, and frees the
+// tree with stop(). Hosts may interleave any number of searches on one
+// thread, each owns its tree and random stream.
+template <class P = DefaultPolicies>
+class Search {
+ public:
+  Search(const ColorWeights& weights, Color color, uint32_t seed,
+         int leaf_rollouts = 1)
+      : weights(weights), color(color), seed(seed),
+        leaf_rollouts(leaf_rollouts) {}
+
+  // Warms up the dot color statistics and creates the root. `expected`
+  // simulations are reserved in the table.
+  void start(const Position& pos, int expected = 100'000) {
+    search = make_unique<SearchContext<P>>(weights, color, seed,
+                                           leaf_rollouts);
+    search->state_store.prepare_for(expected);
+    simulations = 0;
+    for (int w = 0; w < P::WARMUPS; ++w) {
+      Warmup<P>(*search, pos).run();
+    }
+    // the tree is searched from the canonical mirror image of the position
+    root_pos = pos;
+    symmetry = root_pos.get_canonical_symmetry();
+    root_pos.mirror(symmetry);
+    root_pos.update_condidates();
+    // the root tile never changes, it gets a node of its own
+    auto root_afterstate =
+        search->state_store.try_create_afterstate(root_pos).first;
+    root_afterstate->states.emplace_back(root_pos.tile_index, nullptr);
+    root = root_afterstate->try_create_state(root_pos);
+    halving_winner = nullptr;
+  }
+
+  bool running() const { return search != nullptr; }
+
+  // the root has all the visits the tables cover, run_for() does nothing
+  bool exhausted() const { return root->visits >= MAX_VISITS - 1; }
+
+  // Runs `count` simulations, fewer once a child leads the others by more
+  // visits than are left or the root reaches MAX_VISITS - 1 visits, the
+  // end of the BONUS and SQRT tables. Returns the simulations run.
+  int run_for(int count) {
+    return run(nullopt, count);
+  }
+
+  // Runs simulations for `seconds`, at most `max_count` and up to the visit
+  // cap, at least one before the root has a move. Returns the simulations
+  // run.
+  int run_for(double seconds, int max_count = numeric_limits<int>::max()) {
+    return run(get_time_point() + std::chrono::duration_cast<Clock::duration>(
+                                      std::chrono::duration<double>(seconds)),
+               max_count);
+  }
+
+  // Sequential halving at the root instead of the selection. The
+  // `candidates` children of best dot color prior get equal shares of each
+  // round, and the better half by mean value goes on to the next round,
+  // until one is left for best_move(). There are log2(candidates) rounds,
+  // each gets an equal part of the `count` simulations left, at least one
+  // per child. Returns the simulations run.
+  int run_halving(int count, int candidates = HALVING_CANDIDATES) {
+    return halve(nullopt, count, candidates);
+  }
+
+  // The same, each round gets an equal part of `seconds`, at least one
+  // simulation per child.
+  int run_halving(double seconds, int candidates = HALVING_CANDIDATES) {
+    return halve(get_time_point() +
+                     std::chrono::duration_cast<Clock::duration>(
+                         std::chrono::duration<double>(seconds)),
+                 0, candidates);
+  }
+
+  int simulations_count() const { return simulations; }
+
+  // not const: the selection first expands the root to its limit
+  bool consistent() {
+    return root->consistent(root_pos, search->dot_color_stats, symmetry);
+  }
+
+  // Before any simulation, the placement of best dot color prior, which
+  // expands the root: not const, see consistent().
+  PlayerMove best_move() {
+    if (root->actions.empty()) {
+      root->expand(root_pos, search->dot_color_stats, symmetry, nullptr, 1);
+    }
+    auto best = halving_winner ? halving_winner
+                               : root->select_most_visited()->tile_info;
+    return mirror_tile_info(best, symmetry)->move();
+  }
+
+  // not const, see consistent()
+  RootStats root_stats() {
+    RootStats stats{.simulations = simulations,
+                    .rollouts = search->rollouts,
+                    .max_level = search->max_level,
+                    .visits = root->visits,
+                    .consistent = consistent(),
+                    .afterstates = search->state_store.Q.size(),
+                    .buckets = search->state_store.Q.bucket_count(),
+                    .tree_steps = search->tree_steps,
+                    .transposition_hits = search->transposition_hits,
+                    .transpositions = search->transpositions};
+    for (const auto& action_info : root->actions) {
+      stats.children.push_back(
+          {mirror_tile_info(action_info.tile_info, symmetry),
+           action_info.visits, action_info.value, action_info.K,
+           action_info.bias});
+    }
+    ranges::stable_sort(stats.children, greater{}, &ChildStats::visits);
+    if (halving_winner) {
+      auto winner = mirror_tile_info(halving_winner, symmetry);
+      auto it = ranges::find(stats.children, winner, &ChildStats::tile_info);
+      std::rotate(stats.children.begin(), it, it + 1);
+    }
+    return stats;
+  }
+
+  // walk the whole table, meant for the end of a search
+  size_t states_count() const { return search->state_store.states_count(); }
+  size_t memory() const { return search->state_store.memory(); }
+
+  // Frees the tree, start() begins a new search.
+  void stop() {
+    search.reset();
+    root = nullptr;
+    halving_winner = nullptr;
+  }
+
+ private:
+  using Clock = std::chrono::system_clock;
+
+  const ColorWeights& weights;
+  Color color;
+  uint32_t seed;
+  int leaf_rollouts;
+  unique_ptr<SearchContext<P>> search;
+  Position root_pos{"Hh123456h"};
+  int symmetry{IDENTITY};
+  StateInfo<P>* root{nullptr};
+  // in the frame of the tree, the children may move once expanded further
+  const TileInfo* halving_winner{nullptr};
+  int simulations{0};
+
+  void simulate(ActionInfo<P>* first_action = nullptr) {
+    Simulation<P> simulation(*search, root_pos, symmetry);
+    simulation.first_action = first_action;
+    simulation.run();
+    ++simulations;
+  }
+
+  // whether a child leads the others by more than `remaining` visits
+  bool decided(int remaining) const {
+    int first{0};
+    int second{0};
+    for (const auto& action_info : root->actions) {
+      if (action_info.visits > first) {
+        second = first;
+        first = action_info.visits;
+      } else if (action_info.visits > second) {
+        second = action_info.visits;
+      }
+    }
+    return first - second > remaining;
+  }
+
+  int run(optional<Clock::time_point> deadline, int count) {
+    int n{0};
+    for (; n < count && !exhausted() &&
+           (simulations == 0 || !deadline || get_time_point() < *deadline);
+         ++n) {
+      simulate();
+      if (count != numeric_limits<int>::max() && decided(count - n - 1)) {
+        ++n;
+        break;
+      }
+    }
+    return n;
+  }
+
+  int halve(optional<Clock::time_point> deadline, int count, int candidates) {
+    root->expand(root_pos, search->dot_color_stats, symmetry, nullptr,
+                 static_cast<size_t>(max(candidates, 1)));
+    // the root is not expanded during the rounds
+    vector<ActionInfo<P>*> remaining;
+    for (auto& action_info : root->actions) remaining.push_back(&action_info);
+    if (remaining.empty()) return 0;
+    const auto start = get_time_point();
+    const int rounds =
+        max(static_cast<int>(std::bit_width(remaining.size() - 1)), 1);
+    int n{0};
+    for (int round = 0; round < rounds; ++round) {
+      const int k = static_cast<int>(remaining.size());
+      if (deadline) {
+        const auto round_end =
+            start + (*deadline - start) * (round + 1) / rounds;
+        // whole passes, so that the children keep equal visits
+        do {
+          for (auto action_info : remaining) simulate(action_info);
+          n += k;
+        } while (get_time_point() < round_end && !exhausted());
+      } else {
+        const int passes = max((count - n) / ((rounds - round) * k), 1);
+        for (int pass = 0; pass < passes; ++pass) {
+          for (auto action_info : remaining) simulate(action_info);
+          n += k;
+        }
+      }
+      // ties keep the order of the prior
+      ranges::stable_sort(remaining, greater{}, &ActionInfo<P>::value);
+      remaining.resize((k + 1) / 2);
+    }
+    halving_winner = remaining.front()->tile_info;
+    return n;
+  }
+};
+
+// Search `pos` for `max_time` seconds.
+template <class P = DefaultPolicies>
+PlayerMove search_best_move(const Position& pos, AiContext& ctx,
+                            double max_time, SearchStats* stats = nullptr) {
   constexpr int MAX_ITERATIONS{100'000};
 
-  StateStore state_store;
-  state_store.prepare_for(MAX_ITERATIONS);
   auto color = ctx.color;
   auto& log = ctx.log;
   log << fixed << setprecision(2);
   auto start = get_time_point();
-  const auto max_time = get_max_time(pos, ctx);
   log << "max-time=" << max_time << endl;
-  for (int w = 0; w < 1000; ++w) {
-    Warmup(pos, color).run();
+  // an unsolved endgame leaves the other half of the time to the search
+  if (auto move = endgame::solve(pos, ctx, 0.5 * max_time)) {
+    auto dt = get_delta_time_since(start);
+    ctx.total_time += dt;
+    report(pos, ctx, *move,
+           {.source = telemetry::MoveRecord::ENDGAME,
+            .budget = max_time,
+            .time = dt});
+    log << "best-move=" << move->show() << endl;
+    log << string(12, '-') << endl;
+    return *move;
   }
+  // a distinct, reproducible random stream for every move of the game
+  auto seed = ctx.seed ^ (0x9e3779b9u * static_cast<uint32_t>(pos.turn + 1));
+  Search<P> search(ctx.weights, color, seed, ctx.leaf_rollouts);
+  search.start(pos, MAX_ITERATIONS);
   auto wt = get_delta_time_since(start);
   log << "warmup took " << wt << " sec" << endl;
-  int s = 0;
-  pos.update_condidates();
-  for (; s < MAX_ITERATIONS && get_delta_time_since(start) < max_time; ++s) {
-    Simulation(state_store, pos, color).run();
-
-    auto most_visited = state_store.get(pos)->select_most_visited();
-    if (2 * most_visited->visits > MAX_ITERATIONS) {
-      break;
-    }
-  }
+  profile::reset();
+  const bool halving = pos.turn >= ctx.halving_turn;
   int extras{0};
-  auto root = state_store.get(pos);
-  for (; extras < 10'000 && get_delta_time_since(start) < max_time &&
-         !root->consistent(pos);
-       Simulation(state_store, pos, color).run(), ++s, ++extras) {
+  if (halving) {
+    search.run_halving(max_time - get_delta_time_since(start));
+  } else {
+    search.run_for(max_time - get_delta_time_since(start), MAX_ITERATIONS);
+    for (; extras < 10'000 && get_delta_time_since(start) < max_time &&
+           !search.exhausted() && !search.consistent();
+         ++extras) {
+      search.run_for(1);
+    }
   }
 
+  profile::print(log);
   log << "extra=" << extras << endl;
   log << "c=" << pos.get_possible_tiles().size()
-      << " ps=" << pos.get_expected_score(color) << " t=" << pos.turn << endl;
+      << " ps=" << pos.get_expected_score(color, ctx.weights)
+      << " t=" << pos.turn << endl;
 
-  auto most_visited = root->select_most_visited();
-  log << "l=" << Simulation::max_level << " s=" << s
-      << " v=" << most_visited->value << " n=" << most_visited->visits
-      << " p=" << 100.0 * most_visited->visits / root->visits << "%" << endl;
-  if constexpr (USE_DOT_COLOR_STATS) {
-    log << "b=" << most_visited->bias << endl;
+  const auto root = search.root_stats();
+  // the child played
+  const auto& most_visited = root.children.front();
+  const auto s = root.simulations;
+  log << "l=" << root.max_level << " s=" << s << " r=" << root.rollouts
+      << " v=" << most_visited.value << " n=" << most_visited.visits
+      << " p=" << 100.0 * most_visited.visits / root.visits << "%" << endl;
+  if constexpr (P::Selection::DOT_COLOR_STATS) {
+    log << "b=" << most_visited.bias << endl;
   }
-  log << "expanded-count=" << root->actions.size() << endl;
+  log << "expanded-count=" << root.children.size() << endl;
+  const auto memory = search.memory();
+  log << "afterstates=" << root.afterstates
+      << " states=" << search.states_count()
+      << " tree-memory=" << memory / 1024 << "KB" << endl;
+  log << "transpositions=" << root.transpositions << " hits="
+      << 100.0 * static_cast<double>(root.transposition_hits) /
+             static_cast<double>(max(root.tree_steps, size_t{1}))
+      << "%" << endl;
 
-  log << "k=" << most_visited->K << endl;
+  log << "k=" << most_visited.K << endl;
   auto dt = get_delta_time_since(start);
   ctx.total_time += dt;
   log << "impact = ";
-  for (int i : pos.impact(most_visited->tile_info)) {
+  for (int i : pos.impact(most_visited.tile_info)) {
     log << i << " ";
   }
   log << endl;
-  auto best_move = most_visited->tile_info->move();
+  auto best_move = search.best_move();
   log << "best-move=" << best_move.show() << endl;
-  state_store.Q.clear();
+  if (ctx.telemetry) {
+    telemetry::MoveRecord record{.source = halving
+                                               ? telemetry::MoveRecord::HALVING
+                                               : telemetry::MoveRecord::SEARCH,
+                                 .budget = max_time,
+                                 .time = dt,
+                                 .simulations = s,
+                                 .max_depth = root.max_level,
+                                 .expanded = root.children.size(),
+                                 .root_visits = root.visits,
+                                 .afterstates = root.afterstates,
+                                 .buckets = root.buckets,
+                                 .memory = memory};
+    record.top_count = min(static_cast<int>(root.children.size()),
+                           telemetry::TOP_CHILDREN);
+    for (int i = 0; i < record.top_count; ++i) {
+      record.top[i] = {static_cast<int16_t>(root.children[i].tile_info->code),
+                       root.children[i].visits};
+    }
+    report(pos, ctx, best_move, record);
+  }
+  search.stop();
   log << string(12, '-') << endl;
+  if (stats) {
+    *stats = {s,
+              root.rollouts,
+              root.max_level,
+              dt,
+              root.afterstates,
+              root.tree_steps,
+              root.transposition_hits,
+              root.transpositions};
+  }
   double speed = 0.001 * static_cast<double>(s) / dt;
   log << "dt=" << dt << " tt=" << ctx.total_time << " s=" << speed << " Ki/s"
       << endl;
 
   return best_move;
 }
+
+// A book move takes no time, which is left to the following searches.
+inline PlayerMove get_best_move(const Position& pos, AiContext& ctx) {
+  if (ctx.book) {
+    if (auto move = ctx.book->probe(pos, ctx.color)) {
+      report(pos, ctx, *move, {.source = telemetry::MoveRecord::BOOK});
+      ctx.log << "book-move=" << move->show() << endl;
+      ctx.log << string(12, '-') << endl;
+      return *move;
+    }
+  }
+  return search_best_move(pos, ctx, get_max_time(pos, ctx));
+}
+
 }  // namespace mcts_ai
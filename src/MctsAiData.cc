@@ -0,0 +1,21 @@
+#include "MctsAi.h"
+
+namespace mcts_ai {
+
+const array<double, MAX_VISITS> BONUS = []() {
+  array<double, MAX_VISITS> res{};
+  for (int v = 0; v < MAX_VISITS; ++v) {
+    res[v] = sqrt(log(1 + v));
+  }
+  return res;
+}();
+
+const array<double, MAX_VISITS> SQRT = []() {
+  array<double, MAX_VISITS> res{};
+  for (int v = 0; v < MAX_VISITS; ++v) {
+    res[v] = sqrt(v);
+  }
+  return res;
+}();
+
+}  // namespace mcts_ai
@@ -0,0 +1,342 @@
+#pragma once
+
+#include "Position.h"
+#include "Profile.h"
+
+// Policies of the tree search. The search is a template over a bundle of
+// them (see Policies), so each combination compiles to its own hot loop
+// with no runtime switch.
+namespace mcts_ai {
+
+constexpr int MAX_VISITS{200'000};
+
+// sqrt(log(1 + v)) and sqrt(v), built at startup in MctsAiData.cc
+extern const array<double, MAX_VISITS> BONUS;
+extern const array<double, MAX_VISITS> SQRT;
+
+// the tables clamped to their last entry, searches of more visits than
+// MAX_VISITS keep their exploration rate from there
+inline double bonus_of(int visits) {
+  return BONUS[min(visits, MAX_VISITS - 1)];
+}
+inline double sqrt_of(int visits) {
+  return SQRT[min(visits, MAX_VISITS - 1)];
+}
+
+// Selection: the value of an action of the tree from its statistics and the
+// exploration bonus of its node. K0 is the prior deviation of the scores.
+// With DOT_COLOR_STATS the dot color statistics are learned by the search
+// and bias the selection, otherwise only the warmup sets them. With AMAF
+// the backup also updates the all-moves-as-first statistics of the
+// actions.
+
+// UCT with a fixed exploration constant.
+template <double K = 10.0>
+struct Uct {
+  static constexpr double K0{K};
+  static constexpr bool DOT_COLOR_STATS{false};
+  static constexpr bool AMAF{false};
+
+  template <class Action>
+  static double eval(const Action& action, double bonus) {
+    return action.value + K0 * bonus / sqrt_of(1 + action.visits);
+  }
+};
+
+// UCT scaled by the deviation of the scores of each action.
+template <double K = 10.0>
+struct VarianceUct {
+  static constexpr double K0{K};
+  static constexpr bool DOT_COLOR_STATS{false};
+  static constexpr bool AMAF{false};
+
+  template <class Action>
+  static double eval(const Action& action, double bonus) {
+    return action.value + action.K * bonus / sqrt_of(1 + action.visits);
+  }
+};
+
+// Variance UCT plus the dot color estimate of the placement, fading with
+// the visits.
+template <double K = 10.0>
+struct ProgressiveBias {
+  static constexpr double K0{K};
+  static constexpr bool DOT_COLOR_STATS{true};
+  static constexpr bool AMAF{false};
+
+  template <class Action>
+  static double eval(const Action& action, double bonus) {
+    return VarianceUct<K>::eval(action, bonus) +
+           action.bias / (1 + action.visits);
+  }
+};
+
+// Progressive bias with the mean value blended with the all-moves-as-first
+// value: the mean of the simulations in which the player of the node made
+// the placement at this node or later. Its weight
+// sqrt(EQUIVALENCE / (3 visits + EQUIVALENCE)) fades as the action's own
+// visits grow (Gelly and Silver).
+template <double K = 10.0, int EQUIVALENCE = 10000>
+struct Rave {
+  static constexpr double K0{K};
+  static constexpr bool DOT_COLOR_STATS{true};
+  static constexpr bool AMAF{true};
+
+  template <class Action>
+  static double eval(const Action& action, double bonus) {
+    const auto visits = static_cast<double>(action.visits);
+    const double beta =
+        action.amaf.visits > 0
+            ? sqrt(EQUIVALENCE / (3.0 * visits + EQUIVALENCE))
+            : 0.0;
+    return (1.0 - beta) * action.value + beta * action.amaf.value +
+           action.K * bonus / sqrt_of(1 + action.visits) +
+           action.bias / (1 + action.visits);
+  }
+};
+
+// Expansion: the number of children a node with `visits` may have.
+
+// Progressive widening to sqrt(visits + 1) children.
+template <size_t MAX_CHILDREN = 64>
+struct SqrtWidening {
+  static size_t limit(int visits) {
+    return min(static_cast<size_t>(sqrt_of(visits + 1)), MAX_CHILDREN);
+  }
+};
+
+// Rollout: the next move of a rollout at `ply` plies from the leaf, nullptr
+// to stop and score the position. A policy keeps its own data for a search
+// in Tables (SearchContext::rollout_tables) and for a rollout in State.
+
+struct StatelessRollout {
+  struct Tables {};
+  struct State {};
+};
+
+struct UniformRollout : StatelessRollout {
+  template <class Simulation>
+  static const TileInfo* next_move(Position& pos, int /*ply*/,
+                                   Simulation& simulation, State& /*state*/) {
+    return pos.get_random_move(simulation.search.rng);
+  }
+};
+
+// Stops after PLIES plies, the expected score of a position being a
+// reasonable estimate of its final score.
+template <int PLIES = 16>
+struct TruncatedRollout : StatelessRollout {
+  template <class Simulation>
+  static const TileInfo* next_move(Position& pos, int ply,
+                                   Simulation& simulation, State& /*state*/) {
+    return ply < PLIES ? pos.get_random_move(simulation.search.rng) : nullptr;
+  }
+};
+
+// The best of N random legal moves for the dot color statistics.
+template <int N = 2>
+struct BiasedRollout : StatelessRollout {
+  template <class Simulation>
+  static const TileInfo* next_move(Position& pos, int /*ply*/,
+                                   Simulation& simulation, State& /*state*/) {
+    auto& search = simulation.search;
+    const TileInfo* best{nullptr};
+    double best_value{numeric_limits<double>::lowest()};
+    for (int i = 0; i < N; ++i) {
+      auto tile_info = pos.get_random_move(search.rng);
+      if (!tile_info) break;
+      auto value = search.dot_color_stats.evaluate(pos, tile_info,
+                                                   simulation.symmetry);
+      if (best_value < value) {
+        // the move drawn before is still legal
+        if (best) pos.candidates.push_back(best);
+        best_value = value;
+        best = tile_info;
+      } else {
+        pos.candidates.push_back(tile_info);
+      }
+    }
+    return best;
+  }
+};
+
+// Legal placements drawn with weight exp(v / TEMPERATURE), v being the dot
+// color estimate of the placement with the colors of the tile to place.
+// The tile changes every ply, so the draw is from the bound
+// exp(u / TEMPERATURE), u taking the best color of each dot, and is
+// accepted with probability exp((v - u) / TEMPERATURE). The bounds are
+// computed every REFRESH rollouts into a Walker alias table per player,
+// which draws in O(1). A placement played or found illegal leaves the
+// live set of the rollout, and a draw of a placement out of it is
+// rejected.
+template <double TEMPERATURE = 1.0, int REFRESH = 256>
+struct WeightedRollout {
+  // draws rejected before falling back to a uniform draw
+  static constexpr int MAX_REJECTIONS{64};
+
+  // in the frame of the game
+  struct Tables {
+    array<array<float, ALL_TILES_COUNT>, 2> bounds;
+    // the alias tables: placement i is drawn with probability
+    // (probabilities[i] + sum of 1 - probabilities[j] over the j aliased to
+    // i) / ALL_TILES_COUNT
+    array<array<float, ALL_TILES_COUNT>, 2> probabilities;
+    array<array<int16_t, ALL_TILES_COUNT>, 2> aliases;
+    int age{REFRESH};
+
+    template <class DotColorStats>
+    void refresh(const DotColorStats& dot_color_stats) {
+      // best value of each dot for each player, the second player's values
+      // being negated
+      array<array<float, TOTAL_DOTS>, 2> best;
+      for (int dot = 0; dot < TOTAL_DOTS; ++dot) {
+        auto highest = numeric_limits<double>::lowest();
+        auto lowest = numeric_limits<double>::max();
+        for (int c = 0; c < MAX_COLORS; ++c) {
+          const auto color = static_cast<Color>('1' + c);
+          auto value =
+              dot_color_stats.stats[DotColorStats::code(dot, color)].value;
+          highest = max(highest, value);
+          lowest = min(lowest, value);
+        }
+        best[0][dot] = static_cast<float>(highest);
+        best[1][dot] = static_cast<float>(-lowest);
+      }
+      for (int p = 0; p < 2; ++p) {
+        auto highest = numeric_limits<float>::lowest();
+        for (const auto& info : TILES_INFO) {
+          float sum{0.0f};
+          for (auto [d1, d2] : info.siblings) {
+            sum += best[p][d1] + best[p][d2];
+          }
+          bounds[p][info.code] = sum / 12.0f;
+          highest = max(highest, bounds[p][info.code]);
+        }
+        array<float, ALL_TILES_COUNT> weights;
+        float total{0.0f};
+        for (int code = 0; code < ALL_TILES_COUNT; ++code) {
+          weights[code] = std::exp((bounds[p][code] - highest) / TEMPERATURE);
+          total += weights[code];
+        }
+        build_aliases(weights, total, probabilities[p], aliases[p]);
+      }
+      age = 0;
+    }
+
+    // Vose's method
+    static void build_aliases(array<float, ALL_TILES_COUNT>& weights,
+                              float total,
+                              array<float, ALL_TILES_COUNT>& probabilities,
+                              array<int16_t, ALL_TILES_COUNT>& aliases) {
+      array<int16_t, ALL_TILES_COUNT> small;
+      array<int16_t, ALL_TILES_COUNT> large;
+      int small_count{0};
+      int large_count{0};
+      for (int code = 0; code < ALL_TILES_COUNT; ++code) {
+        weights[code] *= ALL_TILES_COUNT / total;
+        aliases[code] = static_cast<int16_t>(code);
+        if (weights[code] < 1.0f) {
+          small[small_count++] = static_cast<int16_t>(code);
+        } else {
+          large[large_count++] = static_cast<int16_t>(code);
+        }
+      }
+      while (small_count > 0 && large_count > 0) {
+        auto s = small[--small_count];
+        auto l = large[large_count - 1];
+        probabilities[s] = weights[s];
+        aliases[s] = l;
+        weights[l] -= 1.0f - weights[s];
+        if (weights[l] < 1.0f) {
+          --large_count;
+          small[small_count++] = l;
+        }
+      }
+      // left over by rounding
+      while (large_count > 0) probabilities[large[--large_count]] = 1.0f;
+      while (small_count > 0) probabilities[small[--small_count]] = 1.0f;
+    }
+
+    int sample(int p, FastRandom& rng) const {
+      auto r = rng.uniform() * ALL_TILES_COUNT;
+      auto code = static_cast<int>(r);
+      return r - code < probabilities[p][code] ? code : aliases[p][code];
+    }
+  };
+
+  struct State {
+    // candidates neither played nor found illegal, in the frame of the game
+    TileSet live;
+  };
+
+  template <class Simulation>
+  static const TileInfo* next_move(Position& pos, int ply,
+                                   Simulation& simulation, State& state) {
+    auto& search = simulation.search;
+    auto& tables = search.rollout_tables;
+    const auto& mirror_codes = TILES_MIRROR_CODES[simulation.symmetry];
+    if (ply == 0) {
+      if (++tables.age >= REFRESH) tables.refresh(search.dot_color_stats);
+      state.live = {};
+      for (auto tile_info : pos.candidates) {
+        state.live.set(mirror_codes[tile_info->code]);
+      }
+    }
+    const int p = pos.player - PLAYER_1;
+    for (int rejections = 0; rejections < MAX_REJECTIONS;) {
+      // every candidate was played or found illegal
+      if (!state.live.any()) return nullptr;
+      const auto code = tables.sample(p, search.rng);
+      if (!state.live.test(code)) {
+        ++rejections;
+        continue;
+      }
+      const auto tile_info = &TILES_INFO[mirror_codes[code]];
+      profile::count(profile::LEGAL_MOVE_CHECKS);
+      if (auto c = tile_info->count_matches(pos.filled);
+          c > Position::MAX_OVERLAPS) {
+        state.live.clear(code);
+        continue;
+      } else if (c == 0 && !tile_info->neighbour_to(pos.filled)) {
+        ++rejections;
+        continue;
+      }
+      const auto value = search.dot_color_stats.evaluate(pos, tile_info,
+                                                         simulation.symmetry);
+      if (search.rng.uniform() <
+          std::exp((value - tables.bounds[p][code]) / TEMPERATURE)) {
+        state.live.clear(code);
+        return tile_info;
+      }
+      ++rejections;
+    }
+    return pos.get_random_move(search.rng);
+  }
+};
+
+// Backup: the value backed up for the final score of a simulation.
+
+struct MeanBackup {
+  static double value(double score) { return score; }
+};
+
+// Only whether the game is won: the margin does not matter for the result.
+struct WinLossBackup {
+  static double value(double score) { return (score > 0.0) - (score < 0.0); }
+};
+
+template <class SelectionPolicy, class ExpansionPolicy, class RolloutPolicy,
+          class BackupPolicy, int WARMUP_ROLLOUTS = 1000>
+struct Policies {
+  using Selection = SelectionPolicy;
+  using Expansion = ExpansionPolicy;
+  using Rollout = RolloutPolicy;
+  using Backup = BackupPolicy;
+  // random games played before the search to seed the dot color statistics
+  static constexpr int WARMUPS{WARMUP_ROLLOUTS};
+};
+
+using DefaultPolicies =
+    Policies<ProgressiveBias<>, SqrtWidening<>, UniformRollout, MeanBackup>;
+
+}  // namespace mcts_ai
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Position.h"
+
+// Precomputed moves of the first placements, written by the `book` tool and
+// memory-mapped by the player. Positions have their colors renamed so that
+// the center tile reads 123456, which makes the book 720 times smaller: the
+// start tile only names the colors.
+namespace opening_book {
+
+constexpr char MAGIC[8] = {'B', 'O', 'X', 'B', 'O', 'O', 'K', '1'};
+
+struct Header {
+  char magic[8];
+  uint64_t count;
+};
+
+// Entries are sorted by hash, then color.
+struct Entry {
+  uint64_t hash;
+  int16_t code;  // TileInfo::code of the move
+  Color color;   // the player's color, renamed like the position
+  char reserved[5];
+
+  auto key() const { return pair{hash, color}; }
+};
+static_assert(sizeof(Entry) == 16);
+
+// Names of the colors that make the center tile read 123456, nullopt once a
+// placement has covered part of it.
+inline optional<array<Color, MAX_COLORS>> center_names(const Position& pos) {
+  array<Color, MAX_COLORS> names{};
+  for (int i = 0; i < TILE_DOTS; ++i) {
+    auto [d1, d2] = CENTER_TILE_INFO->siblings[i];
+    auto color = pos.color(d1);
+    if (color == Position::WHITE || pos.color(d2) != color ||
+        names[color - '1'] != 0) {
+      return nullopt;
+    }
+    names[color - '1'] = static_cast<Color>('1' + i);
+  }
+  return names;
+}
+
+// Key of `pos` for a player of `color`.
+inline optional<pair<uint64_t, Color>> get_key(const Position& pos,
+                                              Color color) {
+  auto names = center_names(pos);
+  if (!names) return nullopt;
+  auto renamed = pos;
+  renamed.rename_colors(*names);
+  return pair{renamed.get_hash(), (*names)[color - '1']};
+}
+
+class Book {
+ public:
+  explicit Book(const string& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    struct stat st {};
+    if (fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(Header))) {
+      size = static_cast<size_t>(st.st_size);
+      data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED) data = nullptr;
+    }
+    close(fd);
+    if (!data) return;
+
+    const auto header = static_cast<const Header*>(data);
+    if (!ranges::equal(header->magic, MAGIC) ||
+        size != sizeof(Header) + header->count * sizeof(Entry)) {
+      munmap(data, size);
+      data = nullptr;
+      return;
+    }
+    entries = {reinterpret_cast<const Entry*>(header + 1), header->count};
+  }
+
+  Book(const Book&) = delete;
+  Book& operator=(const Book&) = delete;
+
+  ~Book() {
+    if (data) munmap(data, size);
+  }
+
+  bool empty() const { return entries.empty(); }
+  size_t count() const { return entries.size(); }
+
+  optional<PlayerMove> probe(const Position& pos, Color color) const {
+    if (entries.empty()) return nullopt;
+    auto key = get_key(pos, color);
+    if (!key) return nullopt;
+    auto it = ranges::lower_bound(entries, *key, {}, &Entry::key);
+    if (it == entries.end() || it->key() != *key) return nullopt;
+    auto tile_info = &TILES_INFO[it->code];
+    // a colliding hash must not play an illegal move
+    if (!pos.possible_move(tile_info)) return nullopt;
+    return tile_info->move();
+  }
+
+  // Write `entries` as a book, sorting them first.
+  static bool write(const string& path, vector<Entry> entries) {
+    ranges::sort(entries, {}, &Entry::key);
+    Header header{};
+    ranges::copy(MAGIC, header.magic);
+    header.count = entries.size();
+    ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(entries.data()),
+              static_cast<std::streamsize>(entries.size() * sizeof(Entry)));
+    return static_cast<bool>(out);
+  }
+
+ private:
+  void* data{nullptr};
+  size_t size{0};
+  span<const Entry> entries;
+};
+
+}  // namespace opening_book
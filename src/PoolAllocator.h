@@ -0,0 +1,210 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+// Per-thread pools of fixed-size blocks, the allocator of the containers of
+// STD.h. Requests are rounded up to a power of two from 16 bytes to 8 KB,
+// each size class having a free list per thread, so no allocation takes a
+// lock. Larger requests go to operator new.
+//
+// A block freed by another thread than the one that allocated it joins the
+// free list of the freeing thread. Pools only grow, but the free lists of a
+// thread that exits go to the next threads that run out of blocks.
+namespace pool_allocator {
+
+constexpr size_t MIN_BLOCK{16};
+constexpr int CLASSES{10};
+constexpr size_t MAX_BLOCK{MIN_BLOCK << (CLASSES - 1)};
+constexpr size_t CHUNK_SIZE{64 * 1024};
+static_assert(CHUNK_SIZE % MAX_BLOCK == 0);
+
+constexpr int size_class(size_t bytes) {
+  return bytes <= MIN_BLOCK
+             ? 0
+             : std::bit_width(bytes - 1) - std::bit_width(MIN_BLOCK - 1);
+}
+static_assert(size_class(16) == 0 && size_class(17) == 1 &&
+              size_class(MAX_BLOCK) == CLASSES - 1);
+
+// Counters of one thread. Only their thread writes them, the atomics let
+// other threads read them.
+struct ThreadStats {
+  int thread{0};
+  std::atomic<uint64_t> allocations{0};
+  std::atomic<uint64_t> deallocations{0};
+  // requests larger than MAX_BLOCK
+  std::atomic<uint64_t> large{0};
+  // chunks carved into blocks
+  std::atomic<uint64_t> chunks{0};
+
+  static void bump(std::atomic<uint64_t>& counter) {
+    counter.store(counter.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_relaxed);
+  }
+};
+
+struct Block {
+  Block* next;
+};
+
+// The counters of every thread that allocated, in order of first use, and
+// the free lists left by the threads that exited.
+class Registry {
+ public:
+  ThreadStats* add() {
+    std::lock_guard lock(stats_mutex);
+    auto& stats = threads.emplace_back(std::make_unique<ThreadStats>());
+    stats->thread = static_cast<int>(threads.size()) - 1;
+    return stats.get();
+  }
+
+  void donate(std::array<Block*, CLASSES>& free) {
+    std::lock_guard lock(depot_mutex);
+    for (int c = 0; c < CLASSES; ++c) {
+      if (free[c]) depot[c].push_back(std::exchange(free[c], nullptr));
+    }
+  }
+
+  // a free list of blocks of `size_class`, nullptr if none is left
+  Block* adopt(int size_class) {
+    std::lock_guard lock(depot_mutex);
+    auto& lists = depot[size_class];
+    if (lists.empty()) return nullptr;
+    auto head = lists.back();
+    lists.pop_back();
+    return head;
+  }
+
+  void print(std::ostream& out) {
+    std::lock_guard lock(stats_mutex);
+    for (const auto& stats : threads) {
+      out << "thread=" << stats->thread
+          << " allocations=" << stats->allocations.load()
+          << " deallocations=" << stats->deallocations.load()
+          << " large=" << stats->large.load()
+          << " chunks=" << stats->chunks.load() << "\n";
+    }
+  }
+
+ private:
+  std::mutex stats_mutex;
+  std::vector<std::unique_ptr<ThreadStats>> threads;
+  std::mutex depot_mutex;
+  std::array<std::vector<Block*>, CLASSES> depot;
+};
+
+// never destroyed, containers may be freed during static destruction
+inline Registry& registry() {
+  static auto registry = new Registry;
+  return *registry;
+}
+
+struct ThreadCache;
+
+// Hands the free lists of its thread to the registry when the thread exits.
+struct Donor {
+  ThreadCache& cache;
+  ~Donor();
+};
+
+// Trivially destructible, so it has neither guard nor destructor, and the
+// containers freed by the destructors of other thread_locals still find it.
+struct ThreadCache {
+  std::array<Block*, CLASSES> free;
+  ThreadStats* stats;
+
+  ThreadStats& get_stats() {
+    if (!stats) {
+      stats = registry().add();
+      static thread_local Donor donor{*this};
+    }
+    return *stats;
+  }
+
+  Block* refill(int size_class) {
+    if (auto head = registry().adopt(size_class)) return head;
+    const size_t block = MIN_BLOCK << size_class;
+    auto chunk = static_cast<char*>(::operator new(CHUNK_SIZE));
+    ThreadStats::bump(get_stats().chunks);
+    Block* head{nullptr};
+    for (size_t offset = CHUNK_SIZE; offset >= block; offset -= block) {
+      auto b = reinterpret_cast<Block*>(chunk + offset - block);
+      b->next = head;
+      head = b;
+    }
+    return head;
+  }
+
+  void* allocate(size_t bytes) {
+    auto& s = get_stats();
+    if (bytes > MAX_BLOCK) {
+      ThreadStats::bump(s.large);
+      return ::operator new(bytes);
+    }
+    ThreadStats::bump(s.allocations);
+    const int c = size_class(bytes);
+    auto b = free[c];
+    if (!b) b = refill(c);
+    free[c] = b->next;
+    return b;
+  }
+
+  void deallocate(void* p, size_t bytes) {
+    if (bytes > MAX_BLOCK) {
+      ::operator delete(p);
+      return;
+    }
+    ThreadStats::bump(get_stats().deallocations);
+    const int c = size_class(bytes);
+    auto b = static_cast<Block*>(p);
+    b->next = free[c];
+    free[c] = b;
+  }
+};
+
+inline constinit thread_local ThreadCache cache{};
+
+inline Donor::~Donor() { registry().donate(cache.free); }
+
+template <class T>
+struct Allocator {
+  using value_type = T;
+
+  Allocator() = default;
+  template <class U>
+  constexpr Allocator(const Allocator<U>&) noexcept {}
+
+  T* allocate(size_t n) {
+    if constexpr (alignof(T) > MIN_BLOCK) {
+      return static_cast<T*>(
+          ::operator new(n * sizeof(T), std::align_val_t{alignof(T)}));
+    } else {
+      return static_cast<T*>(cache.allocate(n * sizeof(T)));
+    }
+  }
+
+  void deallocate(T* p, size_t n) {
+    if constexpr (alignof(T) > MIN_BLOCK) {
+      ::operator delete(p, std::align_val_t{alignof(T)});
+    } else {
+      cache.deallocate(p, n * sizeof(T));
+    }
+  }
+
+  template <class U>
+  bool operator==(const Allocator<U>&) const noexcept {
+    return true;
+  }
+};
+
+}  // namespace pool_allocator
@@ -1,32 +1,77 @@
 #include "Position.h"
 
+#include "Profile.h"
 #include "RNG.h"
 
 namespace {
-const array<array<uint64_t, MAX_COLORS>, TOTAL_DOTS> zobrist_colors = []() {
-  array<array<uint64_t, MAX_COLORS>, TOTAL_DOTS> res;
-  for (int dot : ALL_DOTS) {
-    for (int color : ALL_COLORS) {
-      res[dot][color] = gen.random<uint64_t>();
+// splitmix64, so that the Zobrist keys are fixed at compile time and hashes
+// are the same in every process
+constexpr uint64_t zobrist_key(uint64_t index) {
+  uint64_t z = 0x2545f4914f6cdd1dULL + (index + 1) * 0x9e3779b97f4a7c15ULL;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+constexpr array<array<uint64_t, MAX_COLORS>, TOTAL_DOTS> zobrist_colors = []() {
+  array<array<uint64_t, MAX_COLORS>, TOTAL_DOTS> res{};
+  for (int dot = 0; dot < TOTAL_DOTS; ++dot) {
+    for (int color = 0; color < MAX_COLORS; ++color) {
+      res[dot][color] = zobrist_key(dot * MAX_COLORS + color);
     }
   }
   return res;
 }();
 
-const array<uint64_t, TILES_PERMUTATIONS_COUNT> zobrist_tiles = []() {
-  array<uint64_t, TILES_PERMUTATIONS_COUNT> res;
-  for (int p : iota_view(0, TILES_PERMUTATIONS_COUNT)) {
-    res[p] = gen.random<uint64_t>();
+constexpr array<uint64_t, TILES_PERMUTATIONS_COUNT> zobrist_tiles = []() {
+  array<uint64_t, TILES_PERMUTATIONS_COUNT> res{};
+  for (int p = 0; p < TILES_PERMUTATIONS_COUNT; ++p) {
+    res[p] = zobrist_key(TOTAL_DOTS * MAX_COLORS + p);
   }
   return res;
 }();
 
-const uint64_t zobrist_player_1{gen.random<uint64_t>()};
-const uint64_t zobrist_player_2{gen.random<uint64_t>()};
+constexpr array<array<int16_t, TOTAL_DOTS>, SYMMETRIES> mirror_dots = []() {
+  array<array<int16_t, TOTAL_DOTS>, SYMMETRIES> res{};
+  for (int symmetry = 0; symmetry < SYMMETRIES; ++symmetry) {
+    for (int dot = 0; dot < TOTAL_DOTS; ++dot) {
+      res[symmetry][dot] = static_cast<int16_t>(mirror_dot(dot, symmetry));
+    }
+  }
+  return res;
+}();
+
+// The keys of a colored dot in the hash of each mirror image, side by side
+// so that updating the four hashes is a single vector xor.
+struct alignas(32) MirrorKeys {
+  array<uint64_t, SYMMETRIES> keys;
+};
+
+constexpr array<array<MirrorKeys, MAX_COLORS>, TOTAL_DOTS>
+    zobrist_mirror_colors = []() {
+      array<array<MirrorKeys, MAX_COLORS>, TOTAL_DOTS> res{};
+      for (int dot = 0; dot < TOTAL_DOTS; ++dot) {
+        for (int color = 0; color < MAX_COLORS; ++color) {
+          for (int symmetry = 0; symmetry < SYMMETRIES; ++symmetry) {
+            res[dot][color].keys[symmetry] =
+                zobrist_colors[mirror_dots[symmetry][dot]][color];
+          }
+        }
+      }
+      return res;
+    }();
+
+constexpr uint64_t zobrist_player_1{
+    zobrist_key(TOTAL_DOTS * MAX_COLORS + TILES_PERMUTATIONS_COUNT)};
+constexpr uint64_t zobrist_player_2{
+    zobrist_key(TOTAL_DOTS * MAX_COLORS + TILES_PERMUTATIONS_COUNT + 1)};
 }  // namespace
 
 Position::Position(const string& s) {
-  colors.fill(WHITE);
+  candidates.reserve(ALL_TILES_COUNT);
+  for (const auto& info : TILES_INFO) {
+    candidates.push_back(&info);
+  }
   const auto& [chance_move, _] = parse_moves(s);
   do_move(chance_move);
   for (int i = 0; i < TILE_DOTS; ++i) {
@@ -39,23 +84,26 @@ void Position::update_tile_index(int index) {
     return;
   }
 
-  if (tile_index != -1) {
-    zobrist_hash ^= zobrist_tiles[tile_index];
+  for (int symmetry = 0; symmetry < SYMMETRIES; ++symmetry) {
+    if (tile_index != -1) {
+      zobrist_hashes[symmetry] ^=
+          zobrist_tiles[mirror_tile_index(tile_index, symmetry)];
+    }
+    zobrist_hashes[symmetry] ^= zobrist_tiles[mirror_tile_index(index, symmetry)];
   }
 
-  tile = TILES_PERMUTATIONS[index].c_str();
-  zobrist_hash ^= zobrist_tiles[index];
-  tile_index = index;
+  tile_index = static_cast<int16_t>(index);
 }
 
-void Position::play_chance_move() {
-  auto index = gen.less_than(TILES_PERMUTATIONS_COUNT);
+void Position::play_chance_move(FastRandom& rng) {
+  auto index = rng.less_than(TILES_PERMUTATIONS_COUNT);
   update_tile_index(index);
 }
 
 bool Position::empty(int dot) const { return !filled.test(dot); }
 
 bool Position::possible_move(const TileInfo* tile_info) const {
+  profile::count(profile::LEGAL_MOVE_CHECKS);
   if (auto overlap_count = tile_info->count_matches(filled)) {
     return (overlap_count <= MAX_OVERLAPS);
   } else {
@@ -64,9 +112,8 @@ bool Position::possible_move(const TileInfo* tile_info) const {
 }
 
 bool Position::possible_move(int dot, Orientation orientation) const {
-  auto tile_info = orientation == VERTICAL ? &VERTICAL_TILES_INFO[dot]
-                                           : &HORIZONTAL_TILES_INFO[dot];
-  return possible_move(tile_info);
+  auto tile_info = get_tile_info(dot, orientation);
+  return tile_info && possible_move(tile_info);
 }
 
 vector<const TileInfo*> Position::get_possible_tiles() const {
@@ -74,6 +121,7 @@ vector<const TileInfo*> Position::get_possible_tiles() const {
   possible_tiles.reserve(candidates.size());
 
   auto len = candidates.size();
+  profile::count(profile::LEGAL_MOVE_CHECKS, len);
   auto i = 0u;
   while (i < len) {
     auto tile_info = candidates[i];
@@ -102,6 +150,7 @@ TileSet Position::get_possible_tiles_set() const {
   TileSet res;
 
   auto len = candidates.size();
+  profile::count(profile::LEGAL_MOVE_CHECKS, len);
   auto i = 0u;
   while (i < len) {
     auto tile_info = candidates[i];
@@ -131,6 +180,19 @@ bool Position::end_game() const {
       candidates, [this](auto tile_info) { return possible_move(tile_info); });
 }
 
+// Whatever the colors of the tile, the same dots get filled.
+bool Position::ends_game_after(const TileInfo* tile_info) const {
+  auto after = filled;
+  after |= tile_info->bitboard;
+  profile::count(profile::LEGAL_MOVE_CHECKS, candidates.size());
+  return ranges::none_of(candidates, [&after](auto info) {
+    if (auto overlap_count = info->count_matches(after)) {
+      return overlap_count <= MAX_OVERLAPS;
+    }
+    return info->neighbour_to(after);
+  });
+}
+
 int Position::bonus(int row, int col, int color) const {
   int score{0};
   for (auto v = columns[color][col].value; v > 0;) {
@@ -182,9 +244,9 @@ array<double, MAX_COLORS> Position::get_delta_evals(
   evals.fill(0.0);
   for (int i = 0; i < MAX_COLORS; ++i) {
     auto [d1, d2] = info->siblings[i];
-    auto color = tile[i];
+    auto color = tile_color(i);
     for (int dot : {d1, d2}) {
-      if (auto old_color = colors[dot]; old_color != color) {
+      if (auto old_color = this->color(dot); old_color != color) {
         auto row = dot / COLS;
         auto col = dot % COLS;
         if (old_color != WHITE) {
@@ -217,9 +279,9 @@ array<int, MAX_COLORS> Position::impact(const TileInfo* info) const {
   res.fill(0);
   for (int i = 0; i < MAX_COLORS; ++i) {
     auto [d1, d2] = info->siblings[i];
-    auto color = tile[i];
+    auto color = tile_color(i);
     for (int dot : {d1, d2}) {
-      if (auto old_color = colors[dot]; old_color != color) {
+      if (auto old_color = this->color(dot); old_color != color) {
         auto row = dot / COLS;
         auto col = dot % COLS;
         if (old_color != WHITE) {
@@ -235,25 +297,31 @@ array<int, MAX_COLORS> Position::impact(const TileInfo* info) const {
 }
 
 void Position::update_color(int dot, Color color) {
-  if (auto old_color = colors[dot]; old_color != color) {
-    filled.set(dot);
-    auto row = dot / COLS;
-    auto col = dot % COLS;
-    if (old_color != WHITE) {
-      int old_color_index = old_color - '1';
-      columns[old_color_index][col].unset(row);
-      zobrist_hash ^= zobrist_colors[dot][old_color_index];
+  const auto row = dot / COLS;
+  const auto col = dot % COLS;
+  const int color_index = color - '1';
+  if (columns[color_index][col].test(row)) return;
+
+  const auto& keys = zobrist_mirror_colors[dot];
+  auto key = keys[color_index];
+  if (filled.test(dot)) {
+    const int old_color_index = this->color(dot) - '1';
+    for (int symmetry = 0; symmetry < SYMMETRIES; ++symmetry) {
+      key.keys[symmetry] ^= keys[old_color_index].keys[symmetry];
     }
-    int color_index = color - '1';
-    columns[color_index][col].set(row);
-    colors[dot] = color;
-    zobrist_hash ^= zobrist_colors[dot][color_index];
+    columns[old_color_index][col].unset(row);
+  } else {
+    filled.set(dot);
+  }
+  for (int symmetry = 0; symmetry < SYMMETRIES; ++symmetry) {
+    zobrist_hashes[symmetry] ^= key.keys[symmetry];
   }
+  columns[color_index][col].set(row);
 }
 
 void Position::process_siblings(const TileInfo* tile_info, int index) {
   const auto& [d1, d2] = tile_info->siblings[index];
-  auto color = tile[index];
+  auto color = tile_color(index);
   update_color(d1, color);
   update_color(d2, color);
 }
@@ -277,27 +345,18 @@ void Position::do_move(const TileInfo* tile_info) {
 }
 
 array<int, MAX_COLORS> Position::impact(const PlayerMove& move) const {
-  const auto tile_info = move.orientation == VERTICAL
-                             ? &VERTICAL_TILES_INFO[move.dot]
-                             : &HORIZONTAL_TILES_INFO[move.dot];
-
+  const auto tile_info = get_tile_info(move);
   return impact(tile_info);
 }
 
 array<double, MAX_COLORS> Position::get_delta_evals(
     const PlayerMove& move) const {
-  const auto tile_info = move.orientation == VERTICAL
-                             ? &VERTICAL_TILES_INFO[move.dot]
-                             : &HORIZONTAL_TILES_INFO[move.dot];
-
+  const auto tile_info = get_tile_info(move);
   return get_delta_evals(tile_info);
 }
 
 void Position::do_move(const PlayerMove& move) {
-  const auto tile_info = move.orientation == VERTICAL
-                             ? &VERTICAL_TILES_INFO[move.dot]
-                             : &HORIZONTAL_TILES_INFO[move.dot];
-
+  const auto tile_info = get_tile_info(move);
   do_move(tile_info);
 }
 
@@ -306,9 +365,9 @@ void Position::do_move(const ChanceMove& chance_move) {
   update_tile_index(index);
 }
 
-int Position::get_score(int col, int color) const {
+int Position::get_score(const array<Column, COLS>& color_columns, int col) {
   int score{0};
-  for (auto v = columns[color][col].value; v > 0;) {
+  for (auto v = color_columns[col].value; v > 0;) {
     // Find the least significant set bit
     int row = countr_zero(v);
     // Clear the least significant set bit
@@ -317,7 +376,7 @@ int Position::get_score(int col, int color) const {
     for (uint16_t temp = v; temp > 0; temp &= temp - 1) {
       int b = countr_zero(temp) - row;
       if (col + b >= COLS) break;
-      if (columns[color][col + b].test(row, row + b)) {
+      if (color_columns[col + b].test(row, row + b)) {
         score += b;
       }
     }
@@ -325,14 +384,20 @@ int Position::get_score(int col, int color) const {
   return score;
 }
 
-int Position::get_score(int color) const {
+int Position::get_score(const array<Column, COLS>& color_columns) {
   int score{0};
   for (int col = 0; col < COLS; ++col) {
-    score += get_score(col, color);
+    score += get_score(color_columns, col);
   }
   return score;
 }
 
+int Position::get_score(int col, int color) const {
+  return get_score(columns[color], col);
+}
+
+int Position::get_score(int color) const { return get_score(columns[color]); }
+
 array<int, MAX_COLORS> Position::get_scores() const {
   array<int, MAX_COLORS> scores;
   for (int color : ALL_COLORS) {
@@ -354,21 +419,93 @@ int Position::get_pessimist_score(Color color) const {
   return (s1 - s2);
 }
 
-double Position::get_expected_score(Color color) const {
-  if (opponent_color_index != -1) {
+double Position::get_expected_score(Color color,
+                                    const ColorWeights& w) const {
+  if (w.opponent_color_index != -1) {
     auto my_color_index = color - '1';
-    auto expected = get_score(my_color_index) - get_score(opponent_color_index);
+    auto expected =
+        get_score(my_color_index) - get_score(w.opponent_color_index);
     return expected;
   }
 
   auto scores = get_scores();
   auto expected = 0.0;
   for (int i = 0; i < MAX_COLORS; ++i) {
-    expected += weights[i] * scores[i];
+    expected += w.weights[i] * scores[i];
   }
   return expected;
 }
 
+namespace {
+// color index of each tile slot, for every tile of TILES_PERMUTATIONS
+alignas(32) constexpr array<array<int32_t, TILES_PERMUTATIONS_COUNT>, TILE_DOTS>
+    TILES_SLOT_COLORS = []() {
+      array<array<int32_t, TILES_PERMUTATIONS_COUNT>, TILE_DOTS> res{};
+      // same lexicographic order as TILES_PERMUTATIONS
+      array<int32_t, TILE_DOTS> slot_colors{0, 1, 2, 3, 4, 5};
+      for (int p = 0; p < TILES_PERMUTATIONS_COUNT; ++p) {
+        for (int s = 0; s < TILE_DOTS; ++s) {
+          res[s][p] = slot_colors[s];
+        }
+        std::next_permutation(slot_colors.begin(), slot_colors.end());
+      }
+      return res;
+    }();
+}  // namespace
+
+// Each color goes to exactly one slot of the tile, so the score of a color
+// after the placement only depends on which slot it lands on. That gives a
+// 6x6 table of weighted scores, and the expected score of every tile is the
+// sum of one table entry per slot.
+void Position::get_placement_scores(
+    const TileInfo* tile_info, Color color, const ColorWeights& w,
+    array<float, TILES_PERMUTATIONS_COUNT>& scores) const {
+  array<double, MAX_COLORS> weights = w.weights;
+  if (w.opponent_color_index != -1) {
+    weights.fill(0.0);
+    weights[color - '1'] = 1.0;
+    weights[w.opponent_color_index] = -1.0;
+  }
+
+  alignas(32) array<array<float, 8>, TILE_DOTS> table{};
+  for (int c : ALL_COLORS) {
+    if (weights[c] == 0.0) continue;
+    auto color_columns = columns[c];
+    for (auto [d1, d2] : tile_info->siblings) {
+      color_columns[d1 % COLS].unset(d1 / COLS);
+      color_columns[d2 % COLS].unset(d2 / COLS);
+    }
+    for (int s = 0; s < TILE_DOTS; ++s) {
+      auto slot_columns = color_columns;
+      auto [d1, d2] = tile_info->siblings[s];
+      slot_columns[d1 % COLS].set(d1 / COLS);
+      slot_columns[d2 % COLS].set(d2 / COLS);
+      table[s][c] = static_cast<float>(weights[c] * get_score(slot_columns));
+    }
+  }
+
+#if defined(__AVX2__)
+  for (int p = 0; p < TILES_PERMUTATIONS_COUNT; p += 8) {
+    __m256 sum = _mm256_setzero_ps();
+    for (int s = 0; s < TILE_DOTS; ++s) {
+      __m256 row = _mm256_load_ps(table[s].data());
+      __m256i slot_colors = _mm256_load_si256(
+          reinterpret_cast<const __m256i*>(&TILES_SLOT_COLORS[s][p]));
+      sum = _mm256_add_ps(sum, _mm256_permutevar8x32_ps(row, slot_colors));
+    }
+    _mm256_storeu_ps(&scores[p], sum);
+  }
+#else
+  for (int p = 0; p < TILES_PERMUTATIONS_COUNT; ++p) {
+    float sum{0.0f};
+    for (int s = 0; s < TILE_DOTS; ++s) {
+      sum += table[s][TILES_SLOT_COLORS[s][p]];
+    }
+    scores[p] = sum;
+  }
+#endif
+}
+
 const vector<tuple<int, int, int>> EVAL_DATA = []() {
   vector<tuple<int, int, int>> res;
   for (int col = 0; col < COLS; ++col) {
@@ -410,9 +547,9 @@ double Position::evaluate(Color my_color) const {
 
 string Position::show() const {
   ostringstream out;
-  out << "tile=" << tile << endl << endl;
+  out << "tile=" << show_tile(TILES_PERMUTATIONS[tile_index]) << endl << endl;
   for (int col = 0; int dot : ALL_DOTS) {
-    out << colors[dot];
+    out << color(dot);
     out << "|";
     ++col;
     if (col % COLS == 0) out << endl;
@@ -426,11 +563,12 @@ void Position::remove_candidate(int c) const {
   candidates.pop_back();
 }
 
-const TileInfo* Position::get_random_move() {
+const TileInfo* Position::get_random_move(FastRandom& rng) {
   while (!candidates.empty()) {
     auto candidates_size = static_cast<int>(candidates.size());
-    auto r = gen.less_than(candidates_size);
+    auto r = rng.less_than(candidates_size);
     auto info = candidates[r];
+    profile::count(profile::LEGAL_MOVE_CHECKS);
     if (auto c = info->count_matches(filled)) {
       remove_candidate(r);
       if (c <= MAX_OVERLAPS) {
@@ -444,21 +582,27 @@ const TileInfo* Position::get_random_move() {
   return nullptr;
 }
 
-uint64_t Position::get_hash() const {
-  return player == PLAYER_1 ? (zobrist_hash ^ zobrist_player_1)
-                            : (zobrist_hash ^ zobrist_player_2);
+uint64_t Position::get_hash(int symmetry) const {
+  auto hash = zobrist_hashes[symmetry];
+  return player == PLAYER_1 ? (hash ^ zobrist_player_1)
+                            : (hash ^ zobrist_player_2);
 }
 
-uint64_t Position::compute_hash() const {
+uint64_t Position::get_afterstate_hash(int symmetry) const {
+  auto hash = get_hash(symmetry);
+  return tile_index != -1
+             ? (hash ^ zobrist_tiles[mirror_tile_index(tile_index, symmetry)])
+             : hash;
+}
+
+uint64_t Position::compute_hash(int symmetry) const {
   uint64_t hash{0};
-  for (int dot : ALL_DOTS) {
-    if (auto color = colors[dot]; color != WHITE) {
-      hash ^= zobrist_colors[dot][color - '1'];
-    }
-  }
+  for_each_colored_dot([&](int dot, Color color) {
+    hash ^= zobrist_colors[mirror_dots[symmetry][dot]][color - '1'];
+  });
 
   if (tile_index != -1) {
-    hash ^= zobrist_tiles[tile_index];
+    hash ^= zobrist_tiles[mirror_tile_index(tile_index, symmetry)];
   }
   if (player == PLAYER_1) {
     hash ^= zobrist_player_1;
@@ -468,8 +612,95 @@ uint64_t Position::compute_hash() const {
   return hash;
 }
 
-void Position::update_weigths(const array<double, MAX_COLORS>& impact,
-                              Color my_color) {
+namespace {
+static_assert(ROWS == 16, "a column is reversed as a 16-bit word");
+
+uint16_t reverse_rows(uint16_t value) {
+  uint32_t v = value;
+  v = ((v >> 1) & 0x5555) | ((v & 0x5555) << 1);
+  v = ((v >> 2) & 0x3333) | ((v & 0x3333) << 2);
+  v = ((v >> 4) & 0x0f0f) | ((v & 0x0f0f) << 4);
+  v = ((v >> 8) & 0x00ff) | ((v & 0x00ff) << 8);
+  return static_cast<uint16_t>(v);
+}
+
+using Columns = array<array<Position::Column, COLS>, MAX_COLORS>;
+
+Columns mirror_columns(const Columns& columns, int symmetry) {
+  Columns res;
+  for (int color = 0; color < MAX_COLORS; ++color) {
+    for (int col = 0; col < COLS; ++col) {
+      auto value = columns[color][col].value;
+      if (symmetry & MIRROR_ROWS) value = reverse_rows(value);
+      res[color][(symmetry & MIRROR_COLS) ? COLS - 1 - col : col].value = value;
+    }
+  }
+  return res;
+}
+}  // namespace
+
+int Position::get_canonical_symmetry() const {
+  int res{IDENTITY};
+  auto min_hash = get_afterstate_hash();
+  for (int symmetry = 1; symmetry < SYMMETRIES; ++symmetry) {
+    if (auto hash = get_afterstate_hash(symmetry); hash < min_hash) {
+      min_hash = hash;
+      res = symmetry;
+    }
+  }
+  return res;
+}
+
+bool Position::symmetric(int symmetry) const {
+  return zobrist_hashes[symmetry] == zobrist_hashes[IDENTITY] &&
+         (tile_index == -1 ||
+          mirror_tile_index(tile_index, symmetry) == tile_index) &&
+         mirror_columns(columns, symmetry) == columns;
+}
+
+void Position::mirror(int symmetry) {
+  if (symmetry == IDENTITY) return;
+
+  filled.reset();
+  columns = mirror_columns(columns, symmetry);
+  for_each_colored_dot([this](int dot, Color) { filled.set(dot); });
+
+  // the hash of mirror image t of the result is the one of t ^ symmetry
+  const auto old_hashes = zobrist_hashes;
+  for (int t = 0; t < SYMMETRIES; ++t) {
+    zobrist_hashes[t] = old_hashes[t ^ symmetry];
+  }
+
+  if (tile_index != -1) {
+    tile_index = static_cast<int16_t>(mirror_tile_index(tile_index, symmetry));
+  }
+  for (auto& tile_info : candidates) {
+    tile_info = mirror_tile_info(tile_info, symmetry);
+  }
+}
+
+void Position::rename_colors(const array<Color, MAX_COLORS>& names) {
+  for_each_colored_dot([&](int dot, Color color) {
+    auto name = names[color - '1'];
+    const auto& keys = zobrist_mirror_colors[dot];
+    for (int symmetry = 0; symmetry < SYMMETRIES; ++symmetry) {
+      zobrist_hashes[symmetry] ^=
+          keys[color - '1'].keys[symmetry] ^ keys[name - '1'].keys[symmetry];
+    }
+  });
+  const auto old_columns = columns;
+  for (int color = 0; color < MAX_COLORS; ++color) {
+    columns[names[color] - '1'] = old_columns[color];
+  }
+  if (tile_index != -1) {
+    Tile renamed{show_tile(TILES_PERMUTATIONS[tile_index])};
+    for (auto& color : renamed) color = names[color - '1'];
+    update_tile_index(find_tile_index(renamed));
+  }
+}
+
+void ColorWeights::update_weigths(const array<double, MAX_COLORS>& impact,
+                                  Color my_color, ostream& log) {
   constexpr double BASE{10.0};
   constexpr double T{0.2};
   double min_eval = numeric_limits<double>::max();
@@ -501,12 +732,12 @@ void Position::update_weigths(const array<double, MAX_COLORS>& impact,
   }
 
   if (opponent_color_index != -1) {
-    cerr << "opponent_color_index=" << opponent_color_index << endl;
+    log << "opponent_color_index=" << opponent_color_index << endl;
   }
-  array_log("weights", weights);
+  array_log(log, "weights", weights);
 }
 
-void Position::init_weigths(Color my_color) {
+void ColorWeights::init_weigths(Color my_color) {
   weights.fill(-0.2);
   weights[my_color - '1'] = 1.0;
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Box.h"
+#include "RNG.h"
 
 struct TileSet {
   static constexpr int SIZE = ALL_TILES_COUNT;
@@ -43,7 +44,7 @@ struct TileSet {
       while (current) {
         // Find the index of the least significant set bit
         int bit = countr_zero(current);  // GCC/Clang intrinsic
-        auto tile_info = ALL_TILES_INFO[chunk * CHUNK_SIZE + bit];
+        auto tile_info = &TILES_INFO[chunk * CHUNK_SIZE + bit];
         func(tile_info);
         current &= (current - 1);  // Clear the least significant bit
       }
@@ -60,15 +61,29 @@ struct TileSet {
   }
 };
 
-struct Position {
+// Opponent model of one game: the weight of each color in the expected
+// score, and the opponent color once it is known with enough confidence.
+struct ColorWeights {
+  array<double, MAX_COLORS> weights;
+  int opponent_color_index{-1};
+
+  explicit ColorWeights(Color my_color) { init_weigths(my_color); }
+
+  // the new weights are written to `log`, the log of the game
+  void update_weigths(const array<double, MAX_COLORS>& impact, Color my_color,
+                      ostream& log);
+  void init_weigths(Color my_color);
+};
+
+// The board is stored once, as a 16-bit column word per color and column
+// (the bit of a row is set when the dot has that color), plus the filled
+// dots in the layout of the tile bitboards. The color of a dot is derived
+// from the columns. The hashes, the tile, the turn and the player share the
+// first cache line.
+struct alignas(64) Position {
   static constexpr int MAX_OVERLAPS{4};
   static constexpr Color WHITE{'0'};
 
-  inline static array<double, MAX_COLORS> weights;
-  inline static int opponent_color_index{-1};
-
-  array<Color, TOTAL_DOTS> colors;
-  Bitboard filled;
   struct Column {
     uint16_t value{0};
 
@@ -81,16 +96,46 @@ struct Position {
     bool operator==(const Column& col) const = default;
   };
 
-  array<array<Column, COLS>, MAX_COLORS> columns;
-  const char* tile{nullptr};
-  uint64_t zobrist_hash{0};
-  int tile_index{-1};
-  int turn{0};
+  // Zobrist hash of each mirror image of the position
+  array<uint64_t, SYMMETRIES> zobrist_hashes{};
+  mutable vector<const TileInfo*> candidates;
+  int16_t tile_index{-1};
+  int16_t turn{0};
   Player player{PLAYER_1};
 
+  Bitboard filled;
+  array<array<Column, COLS>, MAX_COLORS> columns{};
+
   explicit Position(const string& s);
 
-  void play_chance_move();
+  Color color(int dot) const {
+    if (!filled.test(dot)) return WHITE;
+    const int row = dot / COLS;
+    const int col = dot % COLS;
+    for (int c = 0; c < MAX_COLORS - 1; ++c) {
+      if (columns[c][col].test(row)) return static_cast<Color>('1' + c);
+    }
+    // a filled dot has one of the colors
+    return static_cast<Color>('0' + MAX_COLORS);
+  }
+
+  // color of slot `i` of the tile to place
+  Color tile_color(int i) const { return TILES_PERMUTATIONS[tile_index][i]; }
+
+  // Calls func(dot, color) for every colored dot.
+  template <typename Func>
+  void for_each_colored_dot(Func func) const {
+    for (int c = 0; c < MAX_COLORS; ++c) {
+      const auto color = static_cast<Color>('1' + c);
+      for (int col = 0; col < COLS; ++col) {
+        for (auto v = columns[c][col].value; v > 0; v &= v - 1) {
+          func(countr_zero(v) * COLS + col, color);
+        }
+      }
+    }
+  }
+
+  void play_chance_move(FastRandom& rng);
 
   bool empty(int dot) const;
   bool possible_move(const TileInfo* tile_info) const;
@@ -109,6 +154,9 @@ struct Position {
   int get_score(int col, int color) const;
   int get_score(int color) const;
   array<int, MAX_COLORS> get_scores() const;
+  void get_placement_scores(const TileInfo* tile_info, Color color,
+                            const ColorWeights& w,
+                            array<float, TILES_PERMUTATIONS_COUNT>& scores) const;
   void do_move(const TileInfo* tile_info);
   void do_move(const PlayerMove& move);
   void do_move(const ChanceMove& move);
@@ -116,18 +164,20 @@ struct Position {
 
   TileSet get_possible_tiles_set() const;
   bool end_game() const;
+  bool ends_game_after(const TileInfo* tile_info) const;
 
   int get_pessimist_score(Color color) const;
-  double get_expected_score(Color color) const;
+  double get_expected_score(Color color, const ColorWeights& w) const;
   double evaluate(Color color) const;
   string show() const;
 
-  mutable vector<const TileInfo*> candidates{ALL_TILES_INFO};
-
-  const TileInfo* get_random_move();
+  const TileInfo* get_random_move(FastRandom& rng);
 
   void remove_candidate(int c) const;
 
+  static int get_score(const array<Column, COLS>& color_columns, int col);
+  static int get_score(const array<Column, COLS>& color_columns);
+
   struct Info {
     array<array<Column, COLS>, MAX_COLORS> columns;
     uint64_t hash;
@@ -135,10 +185,24 @@ struct Position {
     int32_t player;
   };
 
-  uint64_t get_hash() const;
-  uint64_t compute_hash() const;
+  uint64_t get_hash(int symmetry = IDENTITY) const;
+  uint64_t get_afterstate_hash(int symmetry = IDENTITY) const;
+  uint64_t compute_hash(int symmetry = IDENTITY) const;
+
+  // The symmetry giving the smallest afterstate hash, so that all the mirror
+  // images of a position share one node of the search tree.
+  int get_canonical_symmetry() const;
+  // Whether the position is its own mirror image.
+  bool symmetric(int symmetry) const;
+  void mirror(int symmetry);
+  // Rename color c to names[c - '1'] on the board and the tile.
+  void rename_colors(const array<Color, MAX_COLORS>& names);
 
   Info get_info() const { return {columns, get_hash(), tile_index, player}; }
+  // the position before its tile was drawn
+  Info get_afterstate_info() const {
+    return {columns, get_afterstate_hash(), -1, player};
+  }
 
   void update_condidates() const {
     auto len = candidates.size();
@@ -154,8 +218,4 @@ struct Position {
     }
     candidates.resize(len);
   }
-
-  static void update_weigths(const array<double, MAX_COLORS>& impact,
-                             Color my_color);
-  static void init_weigths(Color my_color);
 };
@@ -1,31 +1,23 @@
 #include "Position.h"
 
-bool valid_dot(int r, int c) {
+namespace {
+constexpr bool valid_dot(int r, int c) {
   return r >= 0 && r < ROWS && c >= 0 && c < COLS;
 }
 
-vector<int> get_neighbors(int r, int c) {
-  vector<int> res;
-  if (valid_dot(r + 1, c)) res.push_back(get_dot(r + 1, c));
-  if (valid_dot(r - 1, c)) res.push_back(get_dot(r - 1, c));
-  if (valid_dot(r, c + 1)) res.push_back(get_dot(r, c + 1));
-  if (valid_dot(r, c - 1)) res.push_back(get_dot(r, c - 1));
-  return res;
-}
-
-vector<int> get_neighbors(int dot) {
-  int r = dot / COLS;
-  int c = dot % COLS;
-  return get_neighbors(r, c);
-}
-
-Bitboard generate_tile_neighbors_bitboard(const TileInfo& info) {
+constexpr Bitboard generate_tile_neighbors_bitboard(const TileInfo& info) {
+  constexpr array<pair<int, int>, 4> DIRECTIONS{
+      {{1, 0}, {-1, 0}, {0, 1}, {0, -1}}};
   Bitboard b{};
 
   for (auto [d1, d2] : info.siblings) {
     for (int dot : {d1, d2}) {
-      for (int n : get_neighbors(dot)) {
-        b.set(n);
+      int r = dot / COLS;
+      int c = dot % COLS;
+      for (auto [dr, dc] : DIRECTIONS) {
+        if (valid_dot(r + dr, c + dc)) {
+          b.set(get_dot(r + dr, c + dc));
+        }
       }
     }
   }
@@ -33,153 +25,142 @@ Bitboard generate_tile_neighbors_bitboard(const TileInfo& info) {
   return b;
 }
 
-vector<TileInfo> generate_vertical_tiles_info() {
-  vector<TileInfo> res;
-  for (int dot : ALL_DOTS) {
-    int r = dot / COLS;
-    int c = dot % COLS;
-
-    TileInfo info;
-    // fill dot & orientation
-    info.code = 2 * get_dot(r, c) + 1;
-    info.dot = get_dot(r, c);
-    info.orientation = VERTICAL;
-
-    array<int, TILE_DOTS> top;
-    array<int, TILE_DOTS> bottom;
-    // fill top
-    for (int i = 0; i < TILE_DOTS; ++i) {
-      if (!valid_dot(r + i, c + 1)) {
-        info.clear();
-        break;
-      }
-      int di = get_dot(r + i, c + 1);
-      top[i] = di;
-      info.bitboard.set(di);
-    }
-    if (!info.valid()) {
-      res.push_back(info);
-      continue;
-    }
-    // fill bottom
-    for (int i = 0; i < TILE_DOTS; ++i) {
-      if (!valid_dot(r + i, c)) {
-        info.clear();
-        break;
-      }
-      int di = get_dot(r + i, c);
-      bottom[i] = di;
-      info.bitboard.set(di);
-    }
-
-    if (!info.valid()) {
-      res.push_back(info);
-      continue;
+// The tile with its first bottom dot at (r, c), if it fits on the board.
+// Vertical tiles span rows r..r+5 of columns c (bottom) and c+1 (top),
+// horizontal ones span columns c..c+5 of rows r (top) and r+1 (bottom).
+constexpr optional<TileInfo> generate_tile_info(int r, int c,
+                                                Orientation orientation) {
+  TileInfo info;
+  // fill dot & orientation
+  info.dot = get_dot(r, c);
+  info.orientation = orientation;
+
+  array<int, TILE_DOTS> top{};
+  array<int, TILE_DOTS> bottom{};
+  for (int i = 0; i < TILE_DOTS; ++i) {
+    auto [top_r, top_c] = orientation == VERTICAL ? pair{r + i, c + 1}
+                                                  : pair{r, c + i};
+    auto [bottom_r, bottom_c] = orientation == VERTICAL ? pair{r + i, c}
+                                                        : pair{r + 1, c + i};
+    if (!valid_dot(top_r, top_c) || !valid_dot(bottom_r, bottom_c)) {
+      return nullopt;
     }
-
-    // fill siblings
-    for (int i = 0; i < TILE_DOTS; ++i) {
-      info.siblings[i].first = top[i];
-      info.siblings[i].second = bottom[TILE_DOTS - i - 1];
-    }
-
-    // fill neighbors
-    info.neighbors_bitboard = generate_tile_neighbors_bitboard(info);
-
-    res.push_back(info);
+    top[i] = get_dot(top_r, top_c);
+    bottom[i] = get_dot(bottom_r, bottom_c);
+    info.bitboard.set(top[i]);
+    info.bitboard.set(bottom[i]);
   }
 
-  return res;
-}
+  // fill siblings
+  for (int i = 0; i < TILE_DOTS; ++i) {
+    info.siblings[i].first = top[i];
+    info.siblings[i].second = bottom[TILE_DOTS - i - 1];
+  }
 
-vector<TileInfo> generate_horizontal_tiles_info() {
-  vector<TileInfo> res;
-  for (int dot : ALL_DOTS) {
-    int r = dot / COLS;
-    int c = dot % COLS;
-    TileInfo info;
-    // fill dot & orientation
-    info.code = 2 * get_dot(r, c);
-    info.dot = get_dot(r, c);
-    info.orientation = HORIZONTAL;
-
-    array<int, TILE_DOTS> top;
-    array<int, TILE_DOTS> bottom;
-    // fill top
-    for (int i = 0; i < TILE_DOTS; ++i) {
-      if (!valid_dot(r, c + i)) {
-        info.clear();
-        break;
-      }
-      int di = get_dot(r, c + i);
-      top[i] = di;
-      info.bitboard.set(di);
-    }
+  // fill neighbors
+  info.neighbors_bitboard = generate_tile_neighbors_bitboard(info);
 
-    if (!info.valid()) {
-      res.push_back(info);
-      continue;
-    }
+  return info;
+}
 
-    // fill bottom
-    for (int i = 0; i < TILE_DOTS; ++i) {
-      if (!valid_dot(r + 1, c + i)) {
-        info.clear();
-        break;
+constexpr array<TileInfo, ALL_TILES_COUNT> generate_tiles_info() {
+  array<TileInfo, ALL_TILES_COUNT> res{};
+  int code = 0;
+  for (auto orientation : {VERTICAL, HORIZONTAL}) {
+    for (int dot = 0; dot < TOTAL_DOTS; ++dot) {
+      if (auto info = generate_tile_info(dot / COLS, dot % COLS, orientation)) {
+        info->code = code;
+        res[code++] = *info;
       }
-      int di = get_dot(r + 1, c + i);
-      bottom[i] = di;
-      info.bitboard.set(di);
-    }
-    if (!info.valid()) {
-      res.push_back(info);
-      continue;
-    }
-
-    // fill siblings
-    for (int i = 0; i < TILE_DOTS; ++i) {
-      info.siblings[i].first = top[i];
-      info.siblings[i].second = bottom[TILE_DOTS - i - 1];
     }
-
-    // fill neighbors
-    info.neighbors_bitboard = generate_tile_neighbors_bitboard(info);
-
-    res.push_back(info);
   }
   return res;
 }
 
 // generate all tiles permutations
-vector<Tile> generate_all_tiles_permutations() {
-  Tile tile{"123456"};
-  vector<Tile> res;
+constexpr array<TileColors, TILES_PERMUTATIONS_COUNT>
+generate_all_tiles_permutations() {
+  TileColors tile{'1', '2', '3', '4', '5', '6'};
+  array<TileColors, TILES_PERMUTATIONS_COUNT> res{};
+  int i = 0;
   do {
-    res.push_back(tile);
-  } while (ranges::next_permutation(tile).found);
+    res[i++] = tile;
+  } while (std::next_permutation(tile.begin(), tile.end()));
   return res;
 }
+}  // namespace
 
-const vector<TileInfo> VERTICAL_TILES_INFO = generate_vertical_tiles_info();
-const vector<TileInfo> HORIZONTAL_TILES_INFO = generate_horizontal_tiles_info();
-const vector<Tile> TILES_PERMUTATIONS = generate_all_tiles_permutations();
-const vector<const TileInfo*> ALL_TILES_INFO = []() {
-  vector<const TileInfo*> res;
-  int code = 0;
-  for (const auto& info : VERTICAL_TILES_INFO) {
-    if (info.valid()) {
-      info.code = code++;
-      res.push_back(&info);
-    }
+constexpr array<TileInfo, ALL_TILES_COUNT> TILES_INFO = generate_tiles_info();
+static_assert(TILES_INFO.back().code == ALL_TILES_COUNT - 1);
+
+constexpr array<int16_t, 2 * TOTAL_DOTS> TILES_CODES = []() {
+  array<int16_t, 2 * TOTAL_DOTS> res{};
+  res.fill(-1);
+  for (const auto& info : TILES_INFO) {
+    res[PlayerMove::code(info.dot, info.orientation)] =
+        static_cast<int16_t>(info.code);
   }
-  for (const auto& info : HORIZONTAL_TILES_INFO) {
-    if (info.valid()) {
-      info.code = code++;
-      res.push_back(&info);
+  return res;
+}();
+
+constexpr array<TileColors, TILES_PERMUTATIONS_COUNT> TILES_PERMUTATIONS =
+    generate_all_tiles_permutations();
+
+namespace {
+// The mirror image of a tile has the same orientation, and its first bottom
+// dot is its smallest dot like for any tile.
+constexpr int generate_mirror_code(const TileInfo& info, int symmetry) {
+  int dot = TOTAL_DOTS;
+  for (auto [d1, d2] : info.siblings) {
+    dot = min({dot, mirror_dot(d1, symmetry), mirror_dot(d2, symmetry)});
+  }
+  return TILES_CODES[PlayerMove::code(dot, info.orientation)];
+}
+
+// Whether the slots of every tile map to the slots of its mirror image the
+// way reverses_slots() says, both dots of a slot having the same color.
+constexpr bool check_mirror_slots(
+    const array<array<int16_t, ALL_TILES_COUNT>, SYMMETRIES>& codes) {
+  for (int symmetry = 0; symmetry < SYMMETRIES; ++symmetry) {
+    for (const auto& info : TILES_INFO) {
+      const auto& mirror = TILES_INFO[codes[symmetry][info.code]];
+      for (int i = 0; i < TILE_DOTS; ++i) {
+        auto [d1, d2] = info.siblings[i];
+        auto [m1, m2] =
+            mirror.siblings[reverses_slots(symmetry) ? TILE_DOTS - 1 - i : i];
+        auto [e1, e2] = pair{mirror_dot(d1, symmetry), mirror_dot(d2, symmetry)};
+        if (!((e1 == m1 && e2 == m2) || (e1 == m2 && e2 == m1))) return false;
+      }
     }
   }
+  return true;
+}
+}  // namespace
+
+constexpr array<array<int16_t, ALL_TILES_COUNT>, SYMMETRIES>
+    TILES_MIRROR_CODES = []() {
+      array<array<int16_t, ALL_TILES_COUNT>, SYMMETRIES> res{};
+      for (int symmetry = 0; symmetry < SYMMETRIES; ++symmetry) {
+        for (const auto& info : TILES_INFO) {
+          res[symmetry][info.code] =
+              static_cast<int16_t>(generate_mirror_code(info, symmetry));
+        }
+      }
+      return res;
+    }();
+static_assert(check_mirror_slots(TILES_MIRROR_CODES));
+
+constexpr array<int16_t, TILES_PERMUTATIONS_COUNT> TILES_REVERSED = []() {
+  array<int16_t, TILES_PERMUTATIONS_COUNT> res{};
+  for (int p = 0; p < TILES_PERMUTATIONS_COUNT; ++p) {
+    auto tile = TILES_PERMUTATIONS[p];
+    std::reverse(tile.begin(), tile.end());
+    res[p] = static_cast<int16_t>(
+        ranges::lower_bound(TILES_PERMUTATIONS, tile) -
+        TILES_PERMUTATIONS.begin());
+  }
   return res;
 }();
 
-const TileInfo* const CENTER_TILE_INFO =
-    &HORIZONTAL_TILES_INFO[parse_dot("Hh")];
+constexpr const TileInfo* CENTER_TILE_INFO =
+    &TILES_INFO[TILES_CODES[PlayerMove::code(parse_dot("Hh"), HORIZONTAL)]];
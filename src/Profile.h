@@ -0,0 +1,118 @@
+#pragma once
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "STD.h"
+
+// Cycle and call counts of the phases of a simulation, compiled in with
+// -DBOX_PROFILE=ON. Otherwise every call below is an empty inline function.
+//
+// Phases are exclusive: entering a phase stops the clock of the enclosing
+// one, so the scoring inside a rollout is not counted twice. Time outside
+// any phase goes to OTHER. Counters are per thread, the searches of the
+// arena and of the book generator do not share them.
+namespace profile {
+
+enum Phase {
+  OTHER,
+  SELECTION,
+  EXPANSION,
+  TREE_MOVE,
+  ROLLOUT,
+  SCORING,
+  BACKUP,
+  PHASES
+};
+
+enum Event { LEGAL_MOVE_CHECKS, HASH_PROBES, EVENTS };
+
+constexpr array<const char*, PHASES> PHASE_NAMES{
+    "other", "sel", "exp", "move", "roll", "score", "backup"};
+constexpr array<const char*, EVENTS> EVENT_NAMES{"legal", "probes"};
+
+#ifdef BOX_PROFILE
+
+inline uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return static_cast<uint64_t>(
+      std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+struct Counters {
+  array<uint64_t, PHASES> cycles{};
+  array<uint64_t, PHASES> calls{};
+  array<uint64_t, EVENTS> events{};
+  Phase current{OTHER};
+  uint64_t last{0};
+
+  // switch the running clock to `phase`, returning the phase it stopped
+  Phase enter(Phase phase) {
+    auto now = profile::cycles();
+    this->cycles[current] += now - last;
+    last = now;
+    return std::exchange(current, phase);
+  }
+};
+
+inline thread_local Counters counters;
+
+class Scope {
+ public:
+  explicit Scope(Phase phase) : phase(phase), outer(counters.enter(phase)) {}
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+  ~Scope() {
+    counters.enter(outer);
+    ++counters.calls[phase];
+  }
+
+ private:
+  Phase phase;
+  Phase outer;
+};
+
+inline void count(Event event, uint64_t n = 1) { counters.events[event] += n; }
+
+inline void reset() {
+  counters = {};
+  counters.last = cycles();
+}
+
+// One line per move: Mcycles, share and calls of each phase, then the
+// event counts.
+inline void print(ostream& out) {
+  counters.enter(counters.current);
+  uint64_t total{0};
+  for (auto c : counters.cycles) total += c;
+  out << "profile Mcyc=" << setprecision(1) << 1e-6 * static_cast<double>(total);
+  for (int phase = 0; phase < PHASES; ++phase) {
+    out << " " << PHASE_NAMES[phase] << "="
+        << 1e-6 * static_cast<double>(counters.cycles[phase]) << "M/"
+        << 100.0 * static_cast<double>(counters.cycles[phase]) /
+               static_cast<double>(max(total, uint64_t{1}))
+        << "%/" << counters.calls[phase];
+  }
+  for (int event = 0; event < EVENTS; ++event) {
+    out << " " << EVENT_NAMES[event] << "=" << counters.events[event];
+  }
+  out << setprecision(2) << endl;
+}
+
+#else
+
+struct Scope {
+  explicit Scope(Phase) {}
+};
+
+inline void count(Event, uint64_t = 1) {}
+inline void reset() {}
+inline void print(ostream&) {}
+
+#endif
+
+}  // namespace profile
@@ -5,11 +5,16 @@
 class FastRandom {
  public:
   // Seed for the random number generator
-  explicit FastRandom(uint32_t seed = 123456789) : seed(seed) {}
+  // xorshift32 is stuck at zero, so a zero seed falls back to the default
+  explicit FastRandom(uint32_t seed = 123456789)
+      : seed(seed != 0 ? seed : 123456789) {}
 
   // Generate a random number less than the bound
   int less_than(int bound) { return fast_random(0, bound - 1); }
 
+  // Uniform in [0, 1)
+  double uniform() { return next() * 0x1p-32; }
+
   template <integral T>
   inline T random() {
     uniform_int_distribution<T> uniform_dist(numeric_limits<T>::min(),
@@ -23,13 +28,15 @@ class FastRandom {
   mt19937 engine{r()};
 
   // Fast random number generator xorshift32
-  int fast_random(int min, int max) {
+  uint32_t next() {
     seed ^= seed << 13;
     seed ^= seed >> 17;
     seed ^= seed << 5;
+    return seed;
+  }
+
+  int fast_random(int min, int max) {
     int range = max - min + 1;
-    return min + static_cast<int>(seed % range);
+    return min + static_cast<int>(next() % range);
   }
 };
-
-inline FastRandom gen;
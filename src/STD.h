@@ -2,35 +2,45 @@
 
 #if !defined(__APPLE__)
 #include <immintrin.h>
-
-#include <ext/pool_allocator.h>
 #endif
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <bit>
 #include <bitset>
 #include <cassert>
 #include <chrono>
+#include <condition_variable>
+#include <fstream>
 #include <functional>
 #include <iomanip>
 #include <iostream>
 #include <limits>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <random>
 #include <set>
+#include <span>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 #include <variant>
 #include <vector>
 
+#include "PoolAllocator.h"
+
 using std::array;
+using std::atomic;
 using std::bitset;
 using std::cerr;
 using std::cin;
+using std::condition_variable;
 using std::convertible_to;
 using std::countr_zero;
 using std::cout;
@@ -40,15 +50,23 @@ using std::fixed;
 using std::function;
 using std::greater;
 using std::holds_alternative;
+using std::ifstream;
 using std::integral;
 using std::is_same_v;
+using std::istream;
 using std::less;
+using std::lock_guard;
+using std::make_shared;
 using std::make_unique;
 using std::map;
 using std::max;
 using std::min;
 using std::mt19937;
+using std::mutex;
+using std::nullopt;
 using std::numeric_limits;
+using std::ofstream;
+using std::optional;
 using std::ostream;
 using std::ostringstream;
 using std::pair;
@@ -56,11 +74,15 @@ using std::popcount;
 using std::pow;
 using std::random_device;
 using std::setprecision;
+using std::shared_ptr;
 using std::size_t;
+using std::span;
 using std::sqrt;
 using std::streambuf;
 using std::string;
+using std::string_view;
 using std::swap;
+using std::thread;
 using std::to_string;
 using std::tuple;
 using std::uniform_int_distribution;
@@ -71,13 +93,8 @@ template <class Key, class Compare = std::less<Key>,
           class Allocator = std::allocator<Key>>
 using TreeSet = std::set<Key, Compare, Allocator>;
 
-#if !defined(__APPLE__)
 template <class T>
-using CustomAllocator = __gnu_cxx::__pool_alloc<T>;
-#else
-template <class T>
-using CustomAllocator = std::allocator<T>;
-#endif
+using CustomAllocator = pool_allocator::Allocator<T>;
 
 template <class Key, class T, class Hash, class KeyEqual>
 using HashMap = std::unordered_map<Key, T, Hash, KeyEqual,
@@ -138,8 +155,8 @@ class iota_view {
 };
 
 template <class Array>
-void array_log(const char* name, const Array& arr) {
-  cerr << name << " = ";
-  for (auto& ai : arr) cerr << ai << " ";
-  cerr << endl;
+void array_log(ostream& log, const char* name, const Array& arr) {
+  log << name << " = ";
+  for (auto& ai : arr) log << ai << " ";
+  log << endl;
 }
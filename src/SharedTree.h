@@ -0,0 +1,385 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "MctsAi.h"
+
+// A search tree in a POSIX shared-memory segment, searched by several
+// processes at once (see shmsearch.cc).
+//
+// Nodes hold no pointers: they live in an open-addressing table keyed by
+// the hash of the canonical position with its tile, checked against a
+// second hash of the board (see check_of), and their actions in
+// chunks of a pool referenced by index. All the statistics are atomics
+// updated in place, nothing is ever locked. A worker that dies mid-
+// simulation leaves at most one slot claimed but not written, which is
+// skipped, and the visits it added on the way down.
+//
+// Unlike StateStore, nodes are not shared between the tiles of an
+// afterstate: the per-tile key keeps the layout fixed.
+namespace shared_tree {
+
+constexpr char MAGIC[8] = {'B', 'O', 'X', 'T', 'R', 'E', 'E', '1'};
+constexpr int CHUNK_ACTIONS{8};
+constexpr int MAX_CHUNKS{8};
+constexpr int MAX_ACTIONS{CHUNK_ACTIONS * MAX_CHUNKS};
+constexpr int CODE_WORDS{(ALL_TILES_COUNT + 63) / 64};
+// a lookup probing this many full slots treats the position as a leaf
+constexpr int MAX_PROBES{32};
+
+static_assert(atomic<uint64_t>::is_always_lock_free);
+static_assert(atomic<double>::is_always_lock_free);
+
+struct Action {
+  // TileInfo::code + 1, 0 until the action is written
+  atomic<int16_t> code;
+  float bias;
+  // incremented on the way down, so that concurrent descents spread out
+  atomic<uint32_t> visits;
+  atomic<double> sum;
+  atomic<double> squares;
+};
+
+struct Node {
+  atomic<uint64_t> key;  // 0 for a free slot
+  // check_of the position, 0 until written by the worker claiming the slot
+  atomic<uint64_t> check;
+  atomic<uint32_t> visits;
+  // action slots handed out, some may still be written
+  atomic<uint32_t> reserved;
+  // no legal placement is left to expand
+  atomic<uint32_t> exhausted;
+  // TileInfo codes of the actions
+  array<atomic<uint64_t>, CODE_WORDS> expanded;
+  // index + 1 of each chunk of actions in the pool
+  array<atomic<uint32_t>, MAX_CHUNKS> chunks;
+};
+
+struct Header {
+  char magic[8];
+  uint32_t node_capacity;  // a power of two
+  uint32_t chunk_capacity;
+  atomic<uint32_t> nodes;
+  atomic<uint32_t> chunks;
+  atomic<uint64_t> simulations;
+  atomic<uint32_t> stop;
+};
+
+// A hash of the board, tile and player independent of the Zobrist keys, so
+// that positions whose keys collide get nodes of their own. Never 0.
+inline uint64_t check_of(const Position& pos) {
+  uint64_t h = 0x9e3779b97f4a7c15ULL ^
+               static_cast<uint64_t>(pos.tile_index + 1) ^
+               (static_cast<uint64_t>(pos.player) << 16);
+  for (const auto& color_columns : pos.columns) {
+    for (auto column : color_columns) {
+      h = (h ^ column.value) * 0xff51afd7ed558ccdULL;
+      h ^= h >> 32;
+    }
+  }
+  return h | 1;
+}
+
+// The mapping of a segment, created by the coordinator and inherited by the
+// worker processes it forks.
+class Segment {
+ public:
+  Segment(const string& name, uint32_t node_capacity) : name(name) {
+    node_capacity = std::bit_ceil(max(node_capacity, 1024u));
+    // leaves, most of the nodes, have no actions
+    const uint32_t chunk_capacity = node_capacity / 2;
+    size = sizeof(Header) + node_capacity * sizeof(Node) +
+           chunk_capacity * CHUNK_ACTIONS * sizeof(Action);
+    // an existing segment belongs to another search, it is left alone
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) return;
+    if (ftruncate(fd, static_cast<off_t>(size)) == 0) {
+      data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if (data == MAP_FAILED) data = nullptr;
+    }
+    close(fd);
+    if (!data) {
+      shm_unlink(name.c_str());
+      return;
+    }
+    // the pages are zero: every node and action is free
+    header = static_cast<Header*>(data);
+    ranges::copy(MAGIC, header->magic);
+    header->node_capacity = node_capacity;
+    header->chunk_capacity = chunk_capacity;
+    nodes = reinterpret_cast<Node*>(header + 1);
+    actions = reinterpret_cast<Action*>(nodes + node_capacity);
+  }
+
+  Segment(const Segment&) = delete;
+  Segment& operator=(const Segment&) = delete;
+
+  ~Segment() {
+    if (data) {
+      munmap(data, size);
+      shm_unlink(name.c_str());
+    }
+  }
+
+  bool valid() const { return data != nullptr; }
+  Header& info() const { return *header; }
+
+  // The node of `pos`, created if needed, with whether it was. nullptr
+  // once the table is too full, or while a concurrent worker creating it
+  // has not written its check yet.
+  pair<Node*, bool> find_or_create(const Position& pos) {
+    const uint64_t hash = pos.get_hash();
+    const uint64_t key = hash != 0 ? hash : 1;
+    const uint64_t check = check_of(pos);
+    const uint32_t mask = header->node_capacity - 1;
+    for (uint32_t i = 0, slot = static_cast<uint32_t>(key) & mask;
+         i < MAX_PROBES; ++i, slot = (slot + 1) & mask) {
+      auto& node = nodes[slot];
+      auto current = node.key.load(std::memory_order_acquire);
+      if (current == 0 && node.key.compare_exchange_strong(
+                              current, key, std::memory_order_acq_rel)) {
+        node.check.store(check, std::memory_order_release);
+        header->nodes.fetch_add(1, std::memory_order_relaxed);
+        return {&node, true};
+      }
+      if (current != key) continue;
+      auto node_check = node.check.load(std::memory_order_acquire);
+      if (node_check == 0) return {nullptr, false};
+      if (node_check == check) return {&node, false};
+      // a key collision, the position probes on
+    }
+    return {nullptr, false};
+  }
+
+  Node* find(const Position& pos) const {
+    const uint64_t hash = pos.get_hash();
+    const uint64_t key = hash != 0 ? hash : 1;
+    const uint64_t check = check_of(pos);
+    const uint32_t mask = header->node_capacity - 1;
+    for (uint32_t i = 0, slot = static_cast<uint32_t>(key) & mask;
+         i < MAX_PROBES; ++i, slot = (slot + 1) & mask) {
+      auto current = nodes[slot].key.load(std::memory_order_acquire);
+      if (current == 0) return nullptr;
+      if (current == key &&
+          nodes[slot].check.load(std::memory_order_acquire) == check) {
+        return &nodes[slot];
+      }
+    }
+    return nullptr;
+  }
+
+  // action `slot` of `node`, nullptr if its chunk was never allocated
+  Action* action(const Node& node, uint32_t slot) const {
+    auto chunk = node.chunks[slot / CHUNK_ACTIONS].load(
+        std::memory_order_acquire);
+    return chunk ? &actions[(chunk - 1) * CHUNK_ACTIONS + slot % CHUNK_ACTIONS]
+                 : nullptr;
+  }
+
+  // action `slot` of `node`, allocating its chunk, nullptr once the pool is
+  // used up
+  Action* allocate_action(Node& node, uint32_t slot) {
+    auto& chunk = node.chunks[slot / CHUNK_ACTIONS];
+    if (chunk.load(std::memory_order_acquire) == 0) {
+      auto index = header->chunks.fetch_add(1, std::memory_order_relaxed);
+      if (index >= header->chunk_capacity) return nullptr;
+      // a chunk allocated by a concurrent worker wins, this one is lost
+      uint32_t expected{0};
+      chunk.compare_exchange_strong(expected, index + 1,
+                                    std::memory_order_acq_rel);
+    }
+    return action(node, slot);
+  }
+
+ private:
+  string name;
+  size_t size{0};
+  void* data{nullptr};
+  Header* header{nullptr};
+  Node* nodes{nullptr};
+  Action* actions{nullptr};
+};
+
+template <class P = mcts_ai::DefaultPolicies>
+struct Simulation {
+  // what StateInfo::select reads of an action
+  struct ActionView {
+    double value;
+    double K;
+    double bias;
+    int visits;
+  };
+
+  Segment& segment;
+  // rollouts, dot color statistics and exact scoring of the last ply
+  mcts_ai::Simulation<P> simulation;
+  vector<tuple<Node*, Action*, Player>> transitions;
+
+  Simulation(Segment& segment, mcts_ai::SearchContext<P>& search,
+             const Position& root, int symmetry)
+      : segment(segment), simulation(search, root, symmetry) {}
+
+  // Expands `node` to `limit` actions, best dot color estimates first.
+  void expand(Node& node, uint32_t limit) {
+    auto& pos = simulation.pos;
+    auto candidates = mcts_ai::StateInfo<P>::placements(pos);
+    auto remove = [&](int code) {
+      if (candidates.test(code)) candidates.clear(code);
+    };
+    for (int w = 0; w < CODE_WORDS; ++w) {
+      auto word = node.expanded[w].load(std::memory_order_relaxed);
+      for (; word; word &= word - 1) remove(64 * w + countr_zero(word));
+    }
+    while (node.reserved.load(std::memory_order_relaxed) < limit) {
+      if (!candidates.any()) {
+        node.exhausted.store(1, std::memory_order_relaxed);
+        return;
+      }
+      const TileInfo* selected{nullptr};
+      auto best_value = numeric_limits<double>::lowest();
+      candidates.for_each([&](auto tile_info) {
+        auto value = simulation.search.dot_color_stats.evaluate(
+            pos, tile_info, simulation.symmetry);
+        if (best_value < value) {
+          best_value = value;
+          selected = tile_info;
+        }
+      });
+      const int code = selected->code;
+      remove(code);
+      const auto bit = 1ULL << (code % 64);
+      if (node.expanded[code / 64].fetch_or(bit) & bit) continue;
+      auto slot = node.reserved.fetch_add(1);
+      if (slot >= MAX_ACTIONS) return;
+      auto action = segment.allocate_action(node, slot);
+      if (!action) return;
+      action->bias = static_cast<float>(best_value);
+      action->code.store(static_cast<int16_t>(code + 1),
+                         std::memory_order_release);
+    }
+  }
+
+  Action* select(Node& node) {
+    const auto visits = node.visits.load(std::memory_order_relaxed);
+    const auto limit = static_cast<uint32_t>(
+        min<size_t>(P::Expansion::limit(static_cast<int>(visits)),
+                    MAX_ACTIONS));
+    if (node.reserved.load(std::memory_order_relaxed) < limit &&
+        !node.exhausted.load(std::memory_order_relaxed)) {
+      expand(node, limit);
+    }
+
+    constexpr double K0{P::Selection::K0};
+    const double bonus = mcts_ai::BONUS[min<uint32_t>(
+        visits, mcts_ai::MAX_VISITS - 1)];
+    const auto reserved = min<uint32_t>(
+        node.reserved.load(std::memory_order_acquire), MAX_ACTIONS);
+    Action* best_action{nullptr};
+    double best_value{numeric_limits<double>::lowest()};
+    for (uint32_t slot = 0; slot < reserved; ++slot) {
+      auto action = segment.action(node, slot);
+      if (!action || action->code.load(std::memory_order_acquire) == 0) {
+        continue;
+      }
+      ActionView view{0.0, K0, action->bias, static_cast<int>(min<uint32_t>(
+                                                  action->visits.load(),
+                                                  mcts_ai::MAX_VISITS - 2))};
+      if (view.visits > 0) {
+        auto sum = action->sum.load(std::memory_order_relaxed);
+        auto squares = action->squares.load(std::memory_order_relaxed);
+        view.value = sum / view.visits;
+        auto deviation = max(squares - sum * view.value, 0.0);
+        view.K = sqrt((deviation + K0 * K0) / view.visits);
+      }
+      if (auto value = P::Selection::eval(view, bonus); best_value < value) {
+        best_value = value;
+        best_action = action;
+      }
+    }
+    if (best_action) best_action->visits.fetch_add(1);
+    return best_action;
+  }
+
+  void simulate_tree() {
+    auto& pos = simulation.pos;
+    while (!simulation.exact_score && !pos.end_game()) {
+      // the mirror images of a position share the node of the canonical one
+      auto canonical = pos.get_canonical_symmetry();
+      pos.mirror(canonical);
+      simulation.symmetry ^= canonical;
+      auto [node, created] = segment.find_or_create(pos);
+      if (!node || created) break;
+      auto action = select(*node);
+      if (!action) break;
+      transitions.emplace_back(node, action, pos.player);
+      pos.do_move(&TILES_INFO[action->code.load() - 1]);
+      if (simulation.score_last_ply()) break;
+      pos.play_chance_move(simulation.search.rng);
+    }
+  }
+
+  void backup(double score) const {
+    for (const auto& [node, action, player] : transitions) {
+      auto adjusted_score = player == simulation.player ? score : -score;
+      action->sum.fetch_add(adjusted_score, std::memory_order_relaxed);
+      action->squares.fetch_add(adjusted_score * adjusted_score,
+                                std::memory_order_relaxed);
+      node->visits.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  void run() {
+    simulate_tree();
+    auto& search = simulation.search;
+    search.max_level = max(search.max_level, transitions.size());
+    if (simulation.exact_score) {
+      auto value = P::Backup::value(*simulation.exact_score);
+      simulation.update_dot_color_stats(simulation.pos, value);
+      backup(value);
+    } else {
+      backup(simulation.simulate_default());
+    }
+  }
+};
+
+// Runs simulations from `root`, the canonical image `symmetry` of `pos`,
+// until the coordinator sets the stop flag.
+template <class P = mcts_ai::DefaultPolicies>
+void run_worker(Segment& segment, const Position& pos, const Position& root,
+                int symmetry, const ColorWeights& weights, Color color,
+                uint32_t seed) {
+  mcts_ai::SearchContext<P> search(weights, color, seed);
+  for (int w = 0; w < P::WARMUPS; ++w) {
+    mcts_ai::Warmup<P>(search, pos).run();
+  }
+  auto& info = segment.info();
+  while (!info.stop.load(std::memory_order_relaxed)) {
+    Simulation<P>(segment, search, root, symmetry).run();
+    info.simulations.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+// The most visited action of `root`, in the frame of the game.
+inline pair<const TileInfo*, uint32_t> most_visited(const Segment& segment,
+                                                    const Node& root,
+                                                    int symmetry) {
+  const TileInfo* best{nullptr};
+  uint32_t best_visits{0};
+  const auto reserved = min<uint32_t>(root.reserved.load(), MAX_ACTIONS);
+  for (uint32_t slot = 0; slot < reserved; ++slot) {
+    auto action = segment.action(root, slot);
+    if (!action) continue;
+    auto code = action->code.load();
+    if (code == 0) continue;
+    if (auto visits = action->visits.load(); !best || best_visits < visits) {
+      best_visits = visits;
+      best = &TILES_INFO[code - 1];
+    }
+  }
+  return {best ? mirror_tile_info(best, symmetry) : nullptr, best_visits};
+}
+
+}  // namespace shared_tree
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "Position.h"
+
+// One JSON line per move of the player, for the analysis of many games.
+// The search thread only copies a fixed-size record into a queue; a
+// background thread formats and writes the lines. The file is opened for
+// appending, so the players of concurrent arena games can share it: each
+// write holds whole lines.
+namespace telemetry {
+
+// children of the root listed with their visits, most visited first
+constexpr int TOP_CHILDREN{5};
+
+struct MoveRecord {
+  enum Source : uint8_t { SEARCH, ENDGAME, BOOK, HALVING };
+
+  int turn{0};
+  Color color{'?'};
+  Source source{SEARCH};
+  double budget{0.0};  // seconds
+  double time{0.0};    // seconds
+  int simulations{0};
+  size_t max_depth{0};
+  size_t expanded{0};  // children of the root
+  int root_visits{0};
+  int top_count{0};
+  array<pair<int16_t, int>, TOP_CHILDREN> top{};  // TileInfo::code, visits
+  // transposition table occupancy
+  size_t afterstates{0};
+  size_t buckets{0};
+  size_t memory{0};  // bytes
+  array<double, MAX_COLORS> weights{};
+  PlayerMove move;
+};
+
+class Sink {
+ public:
+  explicit Sink(const string& path)
+      : fd(open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                0644)),
+        writer([this] { write_loop(); }) {}
+
+  Sink(const Sink&) = delete;
+  Sink& operator=(const Sink&) = delete;
+
+  // writes the queued records before returning
+  ~Sink() {
+    {
+      lock_guard lock(queue_mutex);
+      stopping = true;
+    }
+    queue_ready.notify_one();
+    writer.join();
+    if (fd >= 0) close(fd);
+  }
+
+  bool is_open() const { return fd >= 0; }
+
+  void submit(const MoveRecord& record) {
+    {
+      lock_guard lock(queue_mutex);
+      queue.push_back(record);
+    }
+    queue_ready.notify_one();
+  }
+
+ private:
+  int fd;
+  mutex queue_mutex;
+  condition_variable queue_ready;
+  vector<MoveRecord> queue;
+  bool stopping{false};
+  thread writer;
+
+  void write_loop() {
+    vector<MoveRecord> records;
+    string buffer;
+    for (bool done = false; !done;) {
+      {
+        std::unique_lock lock(queue_mutex);
+        queue_ready.wait(lock, [this] { return stopping || !queue.empty(); });
+        swap(records, queue);
+        done = stopping;
+      }
+      buffer.clear();
+      for (const auto& record : records) format(record, buffer);
+      records.clear();
+      for (size_t written = 0; fd >= 0 && written < buffer.size();) {
+        auto n = ::write(fd, buffer.data() + written, buffer.size() - written);
+        if (n <= 0) break;
+        written += static_cast<size_t>(n);
+      }
+    }
+  }
+
+  static void format(const MoveRecord& r, string& out) {
+    static constexpr array<const char*, 4> SOURCES{"search", "endgame",
+                                                    "book", "halving"};
+    ostringstream line;
+    line << fixed << setprecision(4) << "{\"pid\":" << getpid()
+         << ",\"turn\":" << r.turn << ",\"color\":" << r.color - '0'
+         << ",\"source\":\"" << SOURCES[r.source] << "\""
+         << ",\"move\":\"" << r.move.show() << "\""
+         << ",\"budget\":" << r.budget << ",\"time\":" << r.time
+         << ",\"simulations\":" << r.simulations << ",\"speed\":"
+         << (r.time > 0.0 ? static_cast<double>(r.simulations) / r.time : 0.0)
+         << ",\"max_depth\":" << r.max_depth << ",\"expanded\":" << r.expanded
+         << ",\"root_visits\":" << r.root_visits << ",\"top\":[";
+    for (int i = 0; i < r.top_count; ++i) {
+      const auto& [code, visits] = r.top[i];
+      line << (i ? "," : "") << "[\"" << TILES_INFO[code].move().show()
+           << "\"," << visits << "]";
+    }
+    line << "],\"afterstates\":" << r.afterstates << ",\"buckets\":"
+         << r.buckets << ",\"memory\":" << r.memory << ",\"weights\":[";
+    for (int i = 0; i < MAX_COLORS; ++i) {
+      line << (i ? "," : "") << r.weights[i];
+    }
+    line << "]}\n";
+    out += line.str();
+  }
+};
+
+}  // namespace telemetry
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <cstring>
+
+#include "Position.h"
+
+// Positions of self-play games with the search's visit distribution and the
+// result, written by the `selfplay` tool for offline training.
+//
+// The file is a Header followed by blocks. A block is a BlockHeader and the
+// compressed bytes of `records` consecutive Records. The compression only
+// collapses runs of zero bytes, which is most of a record: white dots,
+// empty columns and unvisited placements.
+namespace training_data {
+
+constexpr char MAGIC[8] = {'B', 'O', 'X', 'S', 'E', 'L', 'F', '1'};
+
+// the visit shares are out of this
+constexpr int VISITS_SCALE{65535};
+
+struct Record {
+  // 0 for white, 1 to 6
+  array<uint8_t, TOTAL_DOTS> colors;
+  // Position::columns
+  array<array<uint16_t, COLS>, MAX_COLORS> columns;
+  // share of the root visits of the placement with each TileInfo::code
+  array<uint16_t, ALL_TILES_COUNT> visits;
+  int16_t tile_index;  // in TILES_PERMUTATIONS, the tile to place
+  uint8_t turn;
+  uint8_t color;  // '1' to '6', of the player to move
+  uint8_t player;
+  // the final result for `color`: 1 won, 0 draw, -1 lost
+  int8_t outcome;
+  int16_t score;
+  int16_t opponent_score;
+};
+static_assert(sizeof(Record) == 1438);
+
+struct Header {
+  char magic[8];
+  uint32_t record_size;
+  uint32_t reserved;
+};
+
+struct BlockHeader {
+  uint32_t records;
+  uint32_t size;  // compressed bytes
+};
+
+// A run of zero bytes becomes a zero byte and the length of the run minus
+// one, other bytes are copied.
+inline void compress(span<const uint8_t> in, vector<uint8_t>& out) {
+  for (size_t i = 0; i < in.size();) {
+    if (in[i] != 0) {
+      out.push_back(in[i++]);
+      continue;
+    }
+    size_t run = 1;
+    while (run < 256 && i + run < in.size() && in[i + run] == 0) ++run;
+    out.push_back(0);
+    out.push_back(static_cast<uint8_t>(run - 1));
+    i += run;
+  }
+}
+
+// false if `in` is truncated
+inline bool decompress(span<const uint8_t> in, vector<uint8_t>& out) {
+  for (size_t i = 0; i < in.size(); ++i) {
+    if (in[i] != 0) {
+      out.push_back(in[i]);
+    } else if (i + 1 < in.size()) {
+      out.insert(out.end(), in[++i] + 1u, 0);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+inline Record make_record(const Position& pos, Color color) {
+  Record record{};
+  pos.for_each_colored_dot(
+      [&](int dot, Color c) { record.colors[dot] = c - '0'; });
+  for (int c = 0; c < MAX_COLORS; ++c) {
+    for (int col = 0; col < COLS; ++col) {
+      record.columns[c][col] = pos.columns[c][col].value;
+    }
+  }
+  record.tile_index = static_cast<int16_t>(pos.tile_index);
+  record.turn = static_cast<uint8_t>(pos.turn);
+  record.color = static_cast<uint8_t>(color);
+  record.player = static_cast<uint8_t>(pos.player);
+  return record;
+}
+
+// Appends blocks of records to a file. Blocks are compressed by the
+// calling thread, only the write is serialized.
+class Writer {
+ public:
+  explicit Writer(const string& path) : out(path, std::ios::binary) {
+    Header header{};
+    ranges::copy(MAGIC, header.magic);
+    header.record_size = sizeof(Record);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  }
+
+  bool good() const { return static_cast<bool>(out); }
+
+  void write_block(span<const Record> records) {
+    if (records.empty()) return;
+    vector<uint8_t> block;
+    compress({reinterpret_cast<const uint8_t*>(records.data()),
+              records.size_bytes()},
+             block);
+    BlockHeader header{static_cast<uint32_t>(records.size()),
+                       static_cast<uint32_t>(block.size())};
+    lock_guard lock(out_mutex);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(block.data()),
+              static_cast<std::streamsize>(block.size()));
+    raw_bytes += records.size_bytes();
+    compressed_bytes += sizeof(header) + block.size();
+  }
+
+  size_t raw_size() const { return raw_bytes; }
+  size_t compressed_size() const { return compressed_bytes; }
+
+ private:
+  ofstream out;
+  mutex out_mutex;
+  size_t raw_bytes{0};
+  size_t compressed_bytes{0};
+};
+
+// Reads the blocks of a file written by Writer.
+class Reader {
+ public:
+  explicit Reader(const string& path) : in(path, std::ios::binary) {
+    Header header{};
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    valid = in && ranges::equal(header.magic, MAGIC) &&
+            header.record_size == sizeof(Record);
+  }
+
+  bool good() const { return valid; }
+
+  // the records of the next block, false at the end of the file
+  bool next_block(vector<Record>& records) {
+    BlockHeader header{};
+    if (!valid || !in.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+      return false;
+    }
+    compressed.resize(header.size);
+    if (!in.read(reinterpret_cast<char*>(compressed.data()), header.size)) {
+      return false;
+    }
+    raw.clear();
+    if (!decompress(compressed, raw) ||
+        raw.size() != header.records * sizeof(Record)) {
+      valid = false;
+      return false;
+    }
+    records.resize(header.records);
+    std::memcpy(records.data(), raw.data(), raw.size());
+    return true;
+  }
+
+ private:
+  std::ifstream in;
+  bool valid{false};
+  vector<uint8_t> compressed;
+  vector<uint8_t> raw;
+};
+
+}  // namespace training_data
@@ -0,0 +1,204 @@
+// Batch analysis of positions read from a file.
+//
+//   analyze <input> [--output PATH] [--simulations N] [--threads N]
+//           [--seed S]
+//
+// Each line of the input is one position, the game that leads to it in
+// protocol records (see GameRecord.h). The input is memory-mapped and the
+// positions are shared out to the workers, each searching for a fixed number
+// of simulations with the initial weights of the color. The output has one
+// line per input line, in the same order:
+//
+//   <line> <best-move> <value> <root-visits> <expanded> <move>:<visits>...
+//
+// with the three most visited moves, or `<line> error` for a line that is
+// not a legal position with a move to play.
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "GameRecord.h"
+#include "MctsAi.h"
+
+namespace {
+
+constexpr int TOP_MOVES{3};
+
+struct Options {
+  string input;
+  string output{"analysis.txt"};
+  int simulations{20'000};
+  int threads{static_cast<int>(thread::hardware_concurrency())};
+  uint32_t seed{20240601};
+};
+
+void usage() {
+  cerr << "usage: analyze <input> [--output PATH] [--simulations N]"
+       << " [--threads N] [--seed S]" << endl;
+  std::exit(2);
+}
+
+Options parse_options(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    auto next = [&]() -> string {
+      if (i + 1 >= argc) usage();
+      return argv[++i];
+    };
+    if (arg == "--output") {
+      options.output = next();
+    } else if (arg == "--simulations") {
+      options.simulations = std::stoi(next());
+    } else if (arg == "--threads") {
+      options.threads = std::stoi(next());
+    } else if (arg == "--seed") {
+      options.seed = static_cast<uint32_t>(std::stoul(next()));
+    } else if (options.input.empty() && !arg.starts_with("--")) {
+      options.input = arg;
+    } else {
+      usage();
+    }
+  }
+  if (options.input.empty()) usage();
+  options.threads = max(options.threads, 1);
+  // the root visits index the BONUS and SQRT tables
+  options.simulations =
+      std::clamp(options.simulations, 1, mcts_ai::MAX_VISITS - 1);
+  return options;
+}
+
+// A read-only memory mapping of a whole file.
+class MappedFile {
+ public:
+  explicit MappedFile(const string& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    struct stat st {};
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      size = static_cast<size_t>(st.st_size);
+      data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED) {
+        data = nullptr;
+      } else {
+        madvise(data, size, MADV_SEQUENTIAL);
+      }
+    }
+    close(fd);
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  ~MappedFile() {
+    if (data) munmap(data, size);
+  }
+
+  string_view view() const {
+    return data ? string_view{static_cast<const char*>(data), size}
+                : string_view{};
+  }
+
+ private:
+  void* data{nullptr};
+  size_t size{0};
+};
+
+struct Result {
+  bool ok{false};
+  PlayerMove move;
+  double value{0.0};
+  int root_visits{0};
+  int expanded{0};
+  int top_count{0};
+  array<pair<PlayerMove, int>, TOP_MOVES> top{};
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  using namespace mcts_ai;
+
+  const auto options = parse_options(argc, argv);
+  MappedFile input{options.input};
+  vector<string_view> lines;
+  for (auto text = input.view(); !text.empty();) {
+    auto eol = text.find('\n');
+    lines.push_back(text.substr(0, eol));
+    if (eol == string_view::npos) break;
+    text.remove_prefix(eol + 1);
+  }
+  cout << "positions=" << lines.size() << " threads=" << options.threads
+       << " simulations=" << options.simulations << endl;
+
+  auto start = get_time_point();
+  vector<Result> results(lines.size());
+  atomic<size_t> next_line{0};
+  atomic<size_t> done{0};
+
+  auto worker = [&]() {
+    for (auto i = next_line++; i < lines.size(); i = next_line++) {
+      auto task = game_record::parse_position(lines[i]);
+      if (task) {
+        ColorWeights weights{task->color};
+        Search<> search{weights, task->color,
+                      options.seed ^ static_cast<uint32_t>(i * 0x9e3779b9u)};
+        search.start(task->pos, options.simulations);
+        search.run_for(options.simulations);
+        auto stats = search.root_stats();
+        auto& result = results[i];
+        result.ok = true;
+        result.move = search.best_move();
+        result.value = stats.children.front().value;
+        result.root_visits = stats.visits;
+        result.expanded = static_cast<int>(stats.children.size());
+        result.top_count =
+            min(static_cast<int>(stats.children.size()), TOP_MOVES);
+        for (int t = 0; t < result.top_count; ++t) {
+          result.top[t] = {stats.children[t].tile_info->move(),
+                           stats.children[t].visits};
+        }
+        search.stop();
+      }
+      if (auto n = ++done; n % 100 == 0) {
+        cout << n << "/" << lines.size()
+             << " elapsed=" << get_delta_time_since(start) << "s" << endl;
+      }
+    }
+  };
+
+  vector<thread> workers;
+  for (int i = 1; i < options.threads; ++i) workers.emplace_back(worker);
+  worker();
+  for (auto& w : workers) w.join();
+  auto dt = get_delta_time_since(start);
+
+  ofstream out(options.output);
+  out << fixed << setprecision(3);
+  int errors{0};
+  for (size_t i = 0; i < results.size(); ++i) {
+    const auto& result = results[i];
+    out << i + 1;
+    if (!result.ok) {
+      out << " error\n";
+      ++errors;
+      continue;
+    }
+    out << " " << result.move.show() << " " << result.value << " "
+        << result.root_visits << " " << result.expanded;
+    for (int t = 0; t < result.top_count; ++t) {
+      out << " " << result.top[t].first.show() << ":" << result.top[t].second;
+    }
+    out << "\n";
+  }
+  if (!out) {
+    cerr << "cannot write " << options.output << endl;
+    return 1;
+  }
+  cout << fixed << setprecision(1) << "analyzed=" << results.size() - errors
+       << " errors=" << errors << " time=" << dt << "s"
+       << " speed=" << static_cast<double>(results.size()) / dt
+       << " positions/s" << endl;
+  return 0;
+}
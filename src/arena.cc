@@ -0,0 +1,446 @@
+// Local referee running two player builds against each other over pipes.
+//
+//   arena <engine-a> <engine-b> [--games N] [--concurrency N] [--time SEC]
+//         [--max-turns N] [--seed S] [--sprt ELO0 ELO1] [--alpha A]
+//         [--beta B] [--report N] [--transcripts DIR]
+//
+// Games are played in pairs sharing colors, starting tile and chance tiles,
+// with the engines swapping seats, so the luck of the draw cancels out.
+// With --transcripts, the session of each engine is written to
+// DIR/game-<n>-<engine>.txt: the lines it read with its replies in between,
+// as replayed by the replay tool.
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cmath>
+
+#include "Position.h"
+#include "TimeManagement.h"
+
+namespace {
+
+struct Options {
+  array<string, 2> engines;
+  int games{100};
+  int concurrency{static_cast<int>(thread::hardware_concurrency())};
+  double time_limit{30.0};
+  int max_turns{0};
+  uint32_t seed{random_device{}()};
+  bool sprt{false};
+  double elo0{0.0};
+  double elo1{5.0};
+  double alpha{0.05};
+  double beta{0.05};
+  int report{10};
+  string transcripts;
+};
+
+void usage() {
+  cerr << "usage: arena <engine-a> <engine-b> [--games N] [--concurrency N]"
+       << " [--time SEC] [--max-turns N] [--seed S] [--sprt ELO0 ELO1]"
+       << " [--alpha A] [--beta B] [--report N] [--transcripts DIR]"
+       << endl;
+  std::exit(2);
+}
+
+Options parse_options(int argc, char** argv) {
+  Options options;
+  int positional{0};
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    auto next = [&]() -> string {
+      if (i + 1 >= argc) usage();
+      return argv[++i];
+    };
+    if (arg == "--games") {
+      options.games = std::stoi(next());
+    } else if (arg == "--concurrency") {
+      options.concurrency = std::stoi(next());
+    } else if (arg == "--time") {
+      options.time_limit = std::stod(next());
+    } else if (arg == "--max-turns") {
+      options.max_turns = std::stoi(next());
+    } else if (arg == "--seed") {
+      options.seed = static_cast<uint32_t>(std::stoul(next()));
+    } else if (arg == "--sprt") {
+      options.sprt = true;
+      options.elo0 = std::stod(next());
+      options.elo1 = std::stod(next());
+    } else if (arg == "--alpha") {
+      options.alpha = std::stod(next());
+    } else if (arg == "--beta") {
+      options.beta = std::stod(next());
+    } else if (arg == "--report") {
+      options.report = std::stoi(next());
+    } else if (arg == "--transcripts") {
+      options.transcripts = next();
+    } else if (positional < 2 && !arg.starts_with("--")) {
+      options.engines[positional++] = arg;
+    } else {
+      usage();
+    }
+  }
+  if (positional != 2) usage();
+  options.concurrency = max(options.concurrency, 1);
+  // keep game pairs complete
+  options.games += options.games % 2;
+  return options;
+}
+
+// A player process talking the CodeCup line protocol on stdin/stdout.
+class EngineProcess {
+ public:
+  explicit EngineProcess(const string& path) {
+    int to_child[2];
+    int from_child[2];
+    if (pipe2(to_child, O_CLOEXEC) != 0) return;
+    if (pipe2(from_child, O_CLOEXEC) != 0) {
+      close(to_child[0]);
+      close(to_child[1]);
+      return;
+    }
+    pid = fork();
+    if (pid == 0) {
+      dup2(to_child[0], STDIN_FILENO);
+      dup2(from_child[1], STDOUT_FILENO);
+      if (int null_fd = open("/dev/null", O_WRONLY); null_fd >= 0) {
+        dup2(null_fd, STDERR_FILENO);
+      }
+      execl(path.c_str(), path.c_str(), static_cast<char*>(nullptr));
+      _exit(127);
+    }
+    close(to_child[0]);
+    close(from_child[1]);
+    if (pid < 0) {
+      close(to_child[1]);
+      close(from_child[0]);
+      return;
+    }
+    in_fd = to_child[1];
+    out_fd = from_child[0];
+  }
+
+  EngineProcess(const EngineProcess&) = delete;
+  EngineProcess& operator=(const EngineProcess&) = delete;
+
+  ~EngineProcess() {
+    if (in_fd >= 0) close(in_fd);
+    if (out_fd >= 0) close(out_fd);
+    if (pid > 0) {
+      // give a well-behaved player a moment to exit after "Quit"
+      for (int waited = 0; waitpid(pid, nullptr, WNOHANG) == 0; ++waited) {
+        if (waited == 50) {
+          kill(pid, SIGKILL);
+          waitpid(pid, nullptr, 0);
+          break;
+        }
+        usleep(2'000);
+      }
+    }
+  }
+
+  bool alive() const { return in_fd >= 0 && out_fd >= 0; }
+
+  bool send(const string& line) {
+    if (!alive()) return false;
+    auto data = line + '\n';
+    for (size_t written = 0; written < data.size();) {
+      auto n = write(in_fd, data.data() + written, data.size() - written);
+      if (n <= 0) return false;
+      written += static_cast<size_t>(n);
+    }
+    return true;
+  }
+
+  // Read one line, giving up after `timeout` seconds.
+  optional<string> receive(double timeout) {
+    auto start = get_time_point();
+    while (alive()) {
+      if (auto eol = buffer.find('\n'); eol != string::npos) {
+        auto line = buffer.substr(0, eol);
+        buffer.erase(0, eol + 1);
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+        return line;
+      }
+      auto remaining = timeout - get_delta_time_since(start);
+      if (remaining <= 0.0) break;
+      pollfd pfd{out_fd, POLLIN, 0};
+      auto ready = poll(&pfd, 1, static_cast<int>(std::ceil(remaining * 1e3)));
+      if (ready < 0 && errno == EINTR) continue;
+      if (ready <= 0) break;
+      char chunk[256];
+      auto n = read(out_fd, chunk, sizeof(chunk));
+      if (n <= 0) break;
+      buffer.append(chunk, static_cast<size_t>(n));
+    }
+    return nullopt;
+  }
+
+ private:
+  pid_t pid{-1};
+  int in_fd{-1};
+  int out_fd{-1};
+  string buffer;
+};
+
+enum class Outcome { SCORE, TIMEOUT, ILLEGAL, CRASH };
+
+struct GameResult {
+  // score of engine A: 1 win, 0.5 draw, 0 loss
+  double score{0.5};
+  Outcome outcome{Outcome::SCORE};
+  array<int, 2> points{0, 0};
+  int turns{0};
+  // think time per move, by engine
+  array<vector<double>, 2> think_times;
+};
+
+optional<PlayerMove> parse_player_move(const string& s) {
+  if (s.size() != 3) return nullopt;
+  if (s[0] < 'A' || s[0] >= 'A' + ROWS) return nullopt;
+  if (s[1] < 'a' || s[1] >= 'a' + COLS) return nullopt;
+  if (s[2] != VERTICAL && s[2] != HORIZONTAL) return nullopt;
+  return PlayerMove{parse_dot(s), s[2]};
+}
+
+// Referee one game. In even games engine A moves first, in odd games the
+// engines swap seats (and colors) over the same sequence of tiles.
+GameResult play_game(const Options& options, int game) {
+  mt19937 rng{options.seed + static_cast<uint32_t>(game / 2)};
+  auto random_tile = [&rng]() {
+    auto index = rng() % TILES_PERMUTATIONS_COUNT;
+    return Tile{show_tile(TILES_PERMUTATIONS[index])};
+  };
+
+  array<Color, 2> seat_colors;
+  seat_colors[0] = static_cast<Color>('1' + rng() % MAX_COLORS);
+  do {
+    seat_colors[1] = static_cast<Color>('1' + rng() % MAX_COLORS);
+  } while (seat_colors[1] == seat_colors[0]);
+  auto start_tile = "Hh" + random_tile() + HORIZONTAL;
+
+  // engine index seated at each seat
+  const array<int, 2> seat_engine =
+      game % 2 == 0 ? array<int, 2>{0, 1} : array<int, 2>{1, 0};
+
+  GameResult result;
+  // the lines each seat read and wrote
+  array<vector<string>, 2> transcripts;
+  auto finish = [&](int winner_seat, Outcome outcome) {
+    if (!options.transcripts.empty()) {
+      for (int seat : {0, 1}) {
+        ofstream out(options.transcripts + "/game-" + to_string(game) + "-" +
+                     static_cast<char>('a' + seat_engine[seat]) + ".txt");
+        for (const auto& line : transcripts[seat]) out << line << "\n";
+      }
+    }
+    result.outcome = outcome;
+    if (winner_seat == -1) {
+      result.score = 0.5;
+    } else {
+      result.score = seat_engine[winner_seat] == 0 ? 1.0 : 0.0;
+    }
+    return result;
+  };
+
+  array<unique_ptr<EngineProcess>, 2> seats;
+  for (int seat : {0, 1}) {
+    seats[seat] =
+        make_unique<EngineProcess>(options.engines[seat_engine[seat]]);
+    transcripts[seat] = {string(1, seat_colors[seat]), start_tile};
+    if (!seats[seat]->send(string(1, seat_colors[seat])) ||
+        !seats[seat]->send(start_tile)) {
+      return finish(1 - seat, Outcome::CRASH);
+    }
+  }
+
+  Position pos{start_tile};
+  array<double, 2> used_time{0.0, 0.0};
+  string last_record{"Start"};
+  for (int seat = 0;; seat = 1 - seat, ++result.turns) {
+    if (pos.end_game() ||
+        (options.max_turns > 0 && result.turns >= options.max_turns)) {
+      break;
+    }
+    const auto tile = random_tile();
+    pos.do_move(tile);
+
+    auto& engine = *seats[seat];
+    transcripts[seat].push_back(last_record);
+    transcripts[seat].push_back(tile);
+    auto start = get_time_point();
+    if (!engine.send(last_record) || !engine.send(tile)) {
+      return finish(1 - seat, Outcome::CRASH);
+    }
+    auto reply = engine.receive(options.time_limit - used_time[seat]);
+    auto dt = get_delta_time_since(start);
+    used_time[seat] += dt;
+    result.think_times[seat_engine[seat]].push_back(dt);
+    if (!reply) {
+      return finish(1 - seat, used_time[seat] >= options.time_limit
+                                  ? Outcome::TIMEOUT
+                                  : Outcome::CRASH);
+    }
+    transcripts[seat].push_back(*reply);
+    auto move = parse_player_move(*reply);
+    if (!move || !pos.possible_move(move->dot, move->orientation)) {
+      return finish(1 - seat, Outcome::ILLEGAL);
+    }
+    pos.do_move(*move);
+    last_record = show_dot(move->dot) + tile + move->orientation;
+  }
+
+  for (int seat : {0, 1}) {
+    seats[seat]->send("Quit");
+    transcripts[seat].push_back("Quit");
+    result.points[seat_engine[seat]] = pos.get_score(seat_colors[seat] - '1');
+  }
+  if (result.points[0] == result.points[1]) return finish(-1, Outcome::SCORE);
+  int winner_engine = result.points[0] > result.points[1] ? 0 : 1;
+  int winner_seat = seat_engine[0] == winner_engine ? 0 : 1;
+  return finish(winner_seat, Outcome::SCORE);
+}
+
+double expected_score(double elo) {
+  return 1.0 / (1.0 + pow(10.0, -elo / 400.0));
+}
+
+double elo_of(double score) {
+  score = std::clamp(score, 1e-6, 1.0 - 1e-6);
+  return -400.0 * std::log10(1.0 / score - 1.0);
+}
+
+struct Tally {
+  int played{0};
+  int wins{0};
+  int draws{0};
+  int losses{0};
+  array<int, 4> outcomes{};
+  array<vector<double>, 2> think_times;
+  array<long, 2> points{0, 0};
+
+  void add(const GameResult& result) {
+    ++played;
+    if (result.score == 1.0) {
+      ++wins;
+    } else if (result.score == 0.0) {
+      ++losses;
+    } else {
+      ++draws;
+    }
+    ++outcomes[static_cast<int>(result.outcome)];
+    for (int e : {0, 1}) {
+      points[e] += result.points[e];
+      think_times[e].insert(think_times[e].end(),
+                            result.think_times[e].begin(),
+                            result.think_times[e].end());
+    }
+  }
+
+  double score() const { return (wins + 0.5 * draws) / max(played, 1); }
+
+  double variance() const {
+    auto s = score();
+    auto n = static_cast<double>(max(played, 1));
+    return (wins * (1.0 - s) * (1.0 - s) + draws * (0.5 - s) * (0.5 - s) +
+            losses * s * s) /
+           n;
+  }
+
+  // generalized SPRT log-likelihood ratio of H1 (elo1) against H0 (elo0)
+  double llr(double elo0, double elo1) const {
+    auto var = variance();
+    if (played == 0 || var <= 0.0) return 0.0;
+    auto s0 = expected_score(elo0);
+    auto s1 = expected_score(elo1);
+    return played * (s1 - s0) * (2.0 * score() - s0 - s1) / (2.0 * var);
+  }
+
+  static double percentile(vector<double> values, double p) {
+    if (values.empty()) return 0.0;
+    auto k = static_cast<size_t>(p * static_cast<double>(values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + k, values.end());
+    return values[k];
+  }
+
+  void print(ostream& out, const Options& options) const {
+    auto s = score();
+    auto margin = 1.96 * sqrt(variance() / max(played, 1));
+    out << fixed << setprecision(1);
+    out << "games=" << played << " +" << wins << " =" << draws << " -"
+        << losses << " score=" << 100.0 * s << "%"
+        << " elo=" << elo_of(s) << " [" << elo_of(s - margin) << ", "
+        << elo_of(s + margin) << "]";
+    if (options.sprt) {
+      out << setprecision(2) << " llr=" << llr(options.elo0, options.elo1);
+    }
+    out << endl;
+    out << "forfeits: timeout=" << outcomes[1] << " illegal=" << outcomes[2]
+        << " crash=" << outcomes[3] << endl;
+    out << setprecision(3);
+    for (int e : {0, 1}) {
+      out << "engine-" << static_cast<char>('a' + e) << " "
+          << options.engines[e]
+          << " avg-points=" << static_cast<double>(points[e]) / max(played, 1)
+          << " think p50=" << 1e3 * percentile(think_times[e], 0.50)
+          << "ms p99=" << 1e3 * percentile(think_times[e], 0.99) << "ms"
+          << endl;
+    }
+  }
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  signal(SIGPIPE, SIG_IGN);
+  const auto options = parse_options(argc, argv);
+  cout << "seed=" << options.seed << " games=" << options.games
+       << " concurrency=" << options.concurrency << endl;
+
+  const auto lower = std::log(options.beta / (1.0 - options.alpha));
+  const auto upper = std::log((1.0 - options.beta) / options.alpha);
+
+  mutex tally_mutex;
+  Tally tally;
+  atomic<int> next_game{0};
+  atomic<bool> stop{false};
+  string verdict;
+
+  auto worker = [&]() {
+    while (!stop) {
+      auto game = next_game++;
+      if (game >= options.games) break;
+      auto result = play_game(options, game);
+
+      lock_guard lock(tally_mutex);
+      tally.add(result);
+      if (options.report > 0 && tally.played % options.report == 0) {
+        tally.print(cout, options);
+      }
+      if (options.sprt && tally.played % 2 == 0) {
+        auto llr = tally.llr(options.elo0, options.elo1);
+        if (llr >= upper || llr <= lower) {
+          verdict = llr >= upper ? "H1 accepted" : "H0 accepted";
+          stop = true;
+        }
+      }
+    }
+  };
+
+  vector<thread> workers;
+  for (int i = 0; i < options.concurrency; ++i) workers.emplace_back(worker);
+  for (auto& w : workers) w.join();
+
+  cout << string(12, '-') << endl;
+  tally.print(cout, options);
+  if (options.sprt) {
+    cout << "sprt elo0=" << options.elo0 << " elo1=" << options.elo1
+         << " bounds=[" << lower << ", " << upper << "] "
+         << (verdict.empty() ? "inconclusive" : verdict) << endl;
+  }
+  return 0;
+}
@@ -0,0 +1,291 @@
+// Search benchmark over a fixed set of positions.
+//
+//   bench [--time SEC] [--positions N] [--variants LIST] [--k LIST]
+//         [--threads N] [--games N] [--seed S]
+//
+// Each position comes from a random game. It is searched once with the
+// default policies for ten times the budget to get a reference move, then
+// by each policy variant in LIST with each number of leaf rollouts in LIST
+// (comma separated). The table shows tree descents and rollouts per second
+// and how often the reference move was found, then how often the reference
+// searches met transpositions in each phase of the game: the share of the
+// afterstates reached by more than one edge and of the tree steps into
+// them. With --threads, each search
+// runs on that many threads at once, descents and rollouts being summed
+// over them. The allocation counters of every thread are printed at the
+// end. With --games, each variant also plays paired games against the
+// default policies, at --time seconds per move.
+#include "MctsAi.h"
+
+namespace {
+
+using namespace mcts_ai;
+
+struct Options {
+  double time{0.4};
+  int positions{6};
+  vector<string> variants;
+  vector<int> leaf_rollouts{1};
+  int threads{1};
+  int games{0};
+  uint32_t seed{20240601};
+};
+
+// The search instantiated for one set of policies, with sequential halving
+// at the root from `halving_turn` on.
+struct Variant {
+  string name;
+  PlayerMove (*search)(const Position&, AiContext&, double, SearchStats*);
+  int halving_turn{numeric_limits<int>::max()};
+};
+
+template <class P>
+Variant make_variant(string name,
+                     int halving_turn = numeric_limits<int>::max()) {
+  return {std::move(name), &search_best_move<P>, halving_turn};
+}
+
+const vector<Variant>& all_variants() {
+  static const vector<Variant> variants{
+      make_variant<DefaultPolicies>("default"),
+      make_variant<Policies<Uct<>, SqrtWidening<>, UniformRollout, MeanBackup>>(
+          "uct"),
+      make_variant<
+          Policies<VarianceUct<>, SqrtWidening<>, UniformRollout, MeanBackup>>(
+          "variance-uct"),
+      make_variant<Policies<ProgressiveBias<>, SqrtWidening<32>, UniformRollout,
+                            MeanBackup>>("widening-32"),
+      make_variant<Policies<ProgressiveBias<>, SqrtWidening<>,
+                            TruncatedRollout<16>, MeanBackup>>("truncated-16"),
+      make_variant<Policies<ProgressiveBias<>, SqrtWidening<>,
+                            BiasedRollout<2>, MeanBackup>>("biased-2"),
+      make_variant<Policies<ProgressiveBias<>, SqrtWidening<>,
+                            WeightedRollout<>, MeanBackup>>("weighted"),
+      make_variant<Policies<ProgressiveBias<1.0>, SqrtWidening<>,
+                            UniformRollout, WinLossBackup>>("win-loss"),
+      make_variant<Policies<ProgressiveBias<>, SqrtWidening<>, UniformRollout,
+                            MeanBackup, 100>>("warmup-100"),
+      make_variant<Policies<Rave<>, SqrtWidening<>, UniformRollout,
+                            MeanBackup>>("rave"),
+      make_variant<DefaultPolicies>("halving", 0),
+      make_variant<DefaultPolicies>("halving-late", 20),
+  };
+  return variants;
+}
+
+void usage() {
+  cerr << "usage: bench [--time SEC] [--positions N] [--variants LIST]"
+       << " [--k LIST] [--threads N] [--games N] [--seed S]" << endl
+       << "variants:";
+  for (const auto& variant : all_variants()) cerr << " " << variant.name;
+  cerr << endl;
+  std::exit(2);
+}
+
+vector<string> split(const string& s) {
+  vector<string> res;
+  std::istringstream in(s);
+  for (string item; getline(in, item, ',');) res.push_back(item);
+  return res;
+}
+
+Options parse_options(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    auto next = [&]() -> string {
+      if (i + 1 >= argc) usage();
+      return argv[++i];
+    };
+    if (arg == "--time") {
+      options.time = std::stod(next());
+    } else if (arg == "--positions") {
+      options.positions = std::stoi(next());
+    } else if (arg == "--variants") {
+      options.variants = split(next());
+    } else if (arg == "--k") {
+      options.leaf_rollouts.clear();
+      for (const auto& k : split(next())) {
+        options.leaf_rollouts.push_back(std::stoi(k));
+      }
+    } else if (arg == "--threads") {
+      options.threads = std::stoi(next());
+    } else if (arg == "--games") {
+      options.games = std::stoi(next());
+    } else if (arg == "--seed") {
+      options.seed = static_cast<uint32_t>(std::stoul(next()));
+    } else {
+      usage();
+    }
+  }
+  if (options.variants.empty()) {
+    for (const auto& variant : all_variants()) {
+      options.variants.push_back(variant.name);
+    }
+  }
+  if (options.leaf_rollouts.empty()) usage();
+  options.threads = max(options.threads, 1);
+  return options;
+}
+
+const Variant& find_variant(const string& name) {
+  for (const auto& variant : all_variants()) {
+    if (variant.name == name) return variant;
+  }
+  usage();
+  return all_variants().front();
+}
+
+string random_start_tile(FastRandom& rng) {
+  auto index = rng.less_than(TILES_PERMUTATIONS_COUNT);
+  return "Hh" + string{show_tile(TILES_PERMUTATIONS[index])} + HORIZONTAL;
+}
+
+// Positions spread over the game, each reached by random moves and ready
+// for the player to move.
+vector<Position> sample_positions(const Options& options) {
+  FastRandom rng{options.seed};
+  vector<Position> res;
+  for (int i = 0; i < options.positions; ++i) {
+    const int turns = 2 + 24 * i / max(options.positions, 1);
+    Position pos{random_start_tile(rng)};
+    pos.play_chance_move(rng);
+    for (int t = 0; t < turns; ++t) {
+      auto tile_info = pos.get_random_move(rng);
+      if (!tile_info) break;
+      pos.do_move(tile_info);
+      pos.play_chance_move(rng);
+    }
+    if (!pos.end_game()) res.push_back(pos);
+  }
+  return res;
+}
+
+// Score of `variant` in a game against the default policies, 1 for a win
+// and 0.5 for a draw. The seats swap between the two games of a pair, which
+// see the same colors and tiles.
+double play_game(const Variant& variant, int game, const Options& options) {
+  FastRandom rng{options.seed + 7919u * static_cast<uint32_t>(game / 2 + 1)};
+  array<Color, 2> colors;
+  colors[0] = static_cast<Color>('1' + rng.less_than(MAX_COLORS));
+  do {
+    colors[1] = static_cast<Color>('1' + rng.less_than(MAX_COLORS));
+  } while (colors[1] == colors[0]);
+
+  const auto& reference = all_variants().front();
+  // seat of the variant
+  const int seat = game % 2;
+  array<AiContext, 2> contexts{AiContext{colors[0], NULL_OUT},
+                               AiContext{colors[1], NULL_OUT}};
+  contexts[seat].halving_turn = variant.halving_turn;
+  Position pos{random_start_tile(rng)};
+  for (int s = 0; !pos.end_game(); s = 1 - s) {
+    pos.play_chance_move(rng);
+    const auto& player = s == seat ? variant : reference;
+    pos.do_move(player.search(pos, contexts[s], options.time, nullptr));
+  }
+  auto mine = pos.get_score(colors[seat] - '1');
+  auto theirs = pos.get_score(colors[1 - seat] - '1');
+  return mine > theirs ? 1.0 : mine == theirs ? 0.5 : 0.0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const auto options = parse_options(argc, argv);
+  const auto positions = sample_positions(options);
+
+  struct Row {
+    const Variant* variant;
+    int leaf_rollouts;
+    SearchStats stats;
+    int found{0};
+  };
+  vector<Row> rows;
+  for (const auto& name : options.variants) {
+    for (auto k : options.leaf_rollouts) {
+      rows.push_back({&find_variant(name), k, {}});
+    }
+  }
+
+  // transpositions met by the reference searches, by phase of ten turns
+  constexpr int PHASE_TURNS{10};
+  array<SearchStats, 3> phases{};
+  array<int, 3> phase_positions{};
+  for (const auto& pos : positions) {
+    AiContext reference_ctx{'1', NULL_OUT};
+    SearchStats reference_stats;
+    auto reference = search_best_move(pos, reference_ctx, 10.0 * options.time,
+                                      &reference_stats);
+    cout << "turn=" << pos.turn << " reference=" << reference.show() << endl;
+    auto& phase = phases[min(pos.turn / PHASE_TURNS, 2)];
+    ++phase_positions[min(pos.turn / PHASE_TURNS, 2)];
+    phase.afterstates += reference_stats.afterstates;
+    phase.tree_steps += reference_stats.tree_steps;
+    phase.transposition_hits += reference_stats.transposition_hits;
+    phase.transpositions += reference_stats.transpositions;
+    for (auto& row : rows) {
+      vector<SearchStats> stats(options.threads);
+      vector<PlayerMove> moves(options.threads);
+      auto run = [&](int t) {
+        null_ostream log;
+        AiContext ctx{'1', log};
+        ctx.leaf_rollouts = row.leaf_rollouts;
+        ctx.halving_turn = row.variant->halving_turn;
+        ctx.seed += static_cast<uint32_t>(t);
+        moves[t] = row.variant->search(pos, ctx, options.time, &stats[t]);
+      };
+      vector<thread> threads;
+      for (int t = 1; t < options.threads; ++t) threads.emplace_back(run, t);
+      run(0);
+      for (auto& t : threads) t.join();
+      double time{0.0};
+      for (const auto& thread_stats : stats) {
+        row.stats.simulations += thread_stats.simulations;
+        row.stats.rollouts += thread_stats.rollouts;
+        time = max(time, thread_stats.time);
+      }
+      row.stats.time += time;
+      row.found += moves[0].code() == reference.code();
+    }
+  }
+
+  cout << fixed << setprecision(1);
+  for (const auto& [variant, k, stats, found] : rows) {
+    cout << variant->name << " k=" << k
+         << " descents=" << 1e-3 * stats.simulations / stats.time << " Ki/s"
+         << " rollouts="
+         << 1e-3 * static_cast<double>(stats.rollouts) / stats.time << " Ki/s"
+         << " reference-found=" << found << "/" << positions.size() << endl;
+  }
+
+  for (int i = 0; i < 3; ++i) {
+    const auto& phase = phases[i];
+    cout << "turns=" << PHASE_TURNS * i << "-"
+         << (i < 2 ? to_string(PHASE_TURNS * (i + 1) - 1) : string{"end"})
+         << " positions=" << phase_positions[i] << " transposed="
+         << 100.0 * static_cast<double>(phase.transpositions) /
+                static_cast<double>(max(phase.afterstates, size_t{1}))
+         << "% hits="
+         << 100.0 * static_cast<double>(phase.transposition_hits) /
+                static_cast<double>(max(phase.tree_steps, size_t{1}))
+         << "%" << endl;
+  }
+
+  pool_allocator::registry().print(cout);
+
+  if (options.games > 0) {
+    for (const auto& name : options.variants) {
+      const auto& variant = find_variant(name);
+      if (&variant == &all_variants().front()) continue;
+      double score{0.0};
+      const int games = options.games + options.games % 2;
+      for (int game = 0; game < games; ++game) {
+        score += play_game(variant, game, options);
+      }
+      cout << variant.name << " vs default: score=" << 100.0 * score / games
+           << "% games=" << games << endl;
+    }
+  }
+  return 0;
+}
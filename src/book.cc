@@ -0,0 +1,112 @@
+// Offline generator of the opening book probed by the player.
+//
+//   book [--time SEC] [--threads N] [--colors COLORS] [--tiles N]
+//        [--output PATH]
+//
+// Searches the first placement of the game for every chance tile and every
+// color of the player, with the start tile named 123456 (see OpeningBook.h),
+// and writes the best moves as a memory-mappable book.
+#include "MctsAi.h"
+
+namespace {
+
+struct Options {
+  double time{2.0};
+  int threads{static_cast<int>(thread::hardware_concurrency())};
+  string colors{"123456"};
+  int tiles{TILES_PERMUTATIONS_COUNT};
+  string output{"box.book"};
+};
+
+void usage() {
+  cerr << "usage: book [--time SEC] [--threads N] [--colors COLORS]"
+       << " [--tiles N] [--output PATH]" << endl;
+  std::exit(2);
+}
+
+Options parse_options(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    auto next = [&]() -> string {
+      if (i + 1 >= argc) usage();
+      return argv[++i];
+    };
+    if (arg == "--time") {
+      options.time = std::stod(next());
+    } else if (arg == "--threads") {
+      options.threads = std::stoi(next());
+    } else if (arg == "--colors") {
+      options.colors = next();
+    } else if (arg == "--tiles") {
+      options.tiles = std::stoi(next());
+    } else if (arg == "--output") {
+      options.output = next();
+    } else {
+      usage();
+    }
+  }
+  options.threads = max(options.threads, 1);
+  options.tiles = std::clamp(options.tiles, 1, TILES_PERMUTATIONS_COUNT);
+  if (options.colors.empty() ||
+      !ranges::all_of(options.colors,
+                      [](char c) { return c >= '1' && c < '1' + MAX_COLORS; })) {
+    usage();
+  }
+  return options;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const auto options = parse_options(argc, argv);
+  const auto colors_count = static_cast<int>(options.colors.size());
+  const int total = options.tiles * colors_count;
+  cout << "positions=" << total << " threads=" << options.threads
+       << " time=" << options.time << endl;
+
+  auto start = get_time_point();
+  mutex entries_mutex;
+  vector<opening_book::Entry> entries;
+  entries.reserve(total);
+  atomic<int> next_position{0};
+
+  auto worker = [&]() {
+    null_ostream log;
+    for (auto i = next_position++; i < total; i = next_position++) {
+      const auto color = options.colors[i % colors_count];
+      Position pos{"Hh123456h"};
+      pos.do_move(Tile{show_tile(TILES_PERMUTATIONS[i / colors_count])});
+
+      AiContext ctx{color, log};
+      auto move = mcts_ai::search_best_move(pos, ctx, options.time);
+      auto key = opening_book::get_key(pos, color);
+      assert(key);
+
+      opening_book::Entry entry{};
+      entry.hash = key->first;
+      entry.color = key->second;
+      entry.code = static_cast<int16_t>(get_tile_info(move)->code);
+
+      lock_guard lock(entries_mutex);
+      entries.push_back(entry);
+      if (entries.size() % 100 == 0) {
+        cout << entries.size() << "/" << total
+             << " elapsed=" << get_delta_time_since(start) << "s" << endl;
+      }
+    }
+  };
+
+  vector<thread> workers;
+  for (int i = 1; i < options.threads; ++i) workers.emplace_back(worker);
+  worker();
+  for (auto& w : workers) w.join();
+
+  if (!opening_book::Book::write(options.output, std::move(entries))) {
+    cerr << "cannot write " << options.output << endl;
+    return 1;
+  }
+  cout << "wrote " << total << " entries to " << options.output
+       << " in " << get_delta_time_since(start) << "s" << endl;
+  return 0;
+}
@@ -0,0 +1,258 @@
+// Replay of recorded games, the end-to-end regression benchmark.
+//
+//   replay <transcript>... [--simulations N] [--repeats N] [--seed S]
+//          [--output PATH]
+//
+// A transcript is the session of one player: the lines it read on stdin,
+// in the format of main.cc, with each of its replies on the line after the
+// tile it placed, as the arena writes them with --transcripts:
+//
+//   3
+//   Hh123456h
+//   Start
+//   415263
+//   Fiv
+//   Gg216354h
+//   ...
+//   Quit
+//
+// Every position where the player moved is searched from scratch for a fixed
+// number of simulations with a fixed seed, then the recorded reply is played
+// so the replay follows the game. With --repeats, each position is searched
+// again with other seeds, and the stability is how often they choose the
+// move of the first seed. The output has one line per move:
+//
+//   <transcript> <turn> <move> <reference> <match> <latency-ms>
+//       <simulations> <Ki/s> <afterstates> <states> <memory-KB> <agreement>
+//
+// and the summary goes to stdout.
+#include "GameRecord.h"
+#include "MctsAi.h"
+
+namespace {
+
+struct Options {
+  vector<string> transcripts;
+  int simulations{20'000};
+  int repeats{1};
+  uint32_t seed{20240601};
+  string output{"replay.txt"};
+};
+
+void usage() {
+  cerr << "usage: replay <transcript>... [--simulations N] [--repeats N]"
+       << " [--seed S] [--output PATH]" << endl;
+  std::exit(2);
+}
+
+Options parse_options(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    auto next = [&]() -> string {
+      if (i + 1 >= argc) usage();
+      return argv[++i];
+    };
+    if (arg == "--simulations") {
+      options.simulations = std::stoi(next());
+    } else if (arg == "--repeats") {
+      options.repeats = std::stoi(next());
+    } else if (arg == "--seed") {
+      options.seed = static_cast<uint32_t>(std::stoul(next()));
+    } else if (arg == "--output") {
+      options.output = next();
+    } else if (!arg.starts_with("--")) {
+      options.transcripts.push_back(arg);
+    } else {
+      usage();
+    }
+  }
+  if (options.transcripts.empty()) usage();
+  // the root visits index the BONUS and SQRT tables
+  options.simulations =
+      std::clamp(options.simulations, 1, mcts_ai::MAX_VISITS - 1);
+  options.repeats = max(options.repeats, 1);
+  return options;
+}
+
+struct MoveResult {
+  int turn{0};
+  PlayerMove move;
+  PlayerMove reference;
+  double latency{0.0};
+  int simulations{0};
+  size_t afterstates{0};
+  size_t states{0};
+  size_t memory{0};
+  // searches with other seeds choosing `move`
+  int agreeing{0};
+};
+
+// One search as the player runs it: warmup, simulations and the move.
+MoveResult search_move(const Position& pos, const ColorWeights& weights,
+                       Color color, uint32_t seed, int simulations) {
+  MoveResult result;
+  auto start = get_time_point();
+  mcts_ai::Search<> search{weights, color, seed};
+  search.start(pos, simulations);
+  search.run_for(simulations);
+  result.move = search.best_move();
+  result.latency = get_delta_time_since(start);
+  const auto root = search.root_stats();
+  result.turn = pos.turn;
+  result.simulations = root.simulations;
+  result.afterstates = root.afterstates;
+  result.states = search.states_count();
+  result.memory = search.memory();
+  search.stop();
+  return result;
+}
+
+// The moves of the player in a transcript, nullopt and a message on
+// `error` if it is not a legal session.
+optional<vector<MoveResult>> replay(istream& in, const Options& options,
+                                    string& error) {
+  string s;
+  Color color;
+  if (!(in >> color) || color < '1' || color >= '1' + MAX_COLORS ||
+      !(in >> s) || s.size() != 9 || !game_record::valid_dot(s) ||
+      !game_record::valid_tile(s.substr(2, TILE_DOTS)) ||
+      (s[8] != VERTICAL && s[8] != HORIZONTAL)) {
+    error = "bad header";
+    return nullopt;
+  }
+  Position pos{s};
+  ColorWeights weights{color};
+  array<double, MAX_COLORS> total_delta_evals{};
+  vector<MoveResult> results;
+  while (in >> s && s != "Quit") {
+    auto fail = [&](string what) {
+      error = what + " at turn " + to_string(pos.turn);
+      return nullopt;
+    };
+    if (s != "Start") {
+      if (s.size() != 9 || !game_record::valid_dot(s) ||
+          !game_record::valid_tile(s.substr(2, TILE_DOTS)) || pos.end_game()) {
+        return fail("bad record " + s);
+      }
+      const auto [chance_move, opponent_move] = parse_moves(s);
+      pos.do_move(chance_move);
+      if (!pos.possible_move(opponent_move.dot, opponent_move.orientation)) {
+        return fail("illegal record " + s);
+      }
+      // the player adapts the weights to the opponent as it goes
+      auto delta_evals = pos.get_delta_evals(opponent_move);
+      for (int i = 0; i < MAX_COLORS; ++i) {
+        total_delta_evals[i] += delta_evals[i];
+      }
+      weights.update_weigths(total_delta_evals, color, NULL_OUT);
+      pos.do_move(opponent_move);
+    }
+    if (!(in >> s) || !game_record::valid_tile(s) || pos.end_game()) {
+      return fail("bad tile");
+    }
+    pos.do_move(ChanceMove{s});
+    string reply;
+    // the game ended on a forfeit of the player
+    if (!(in >> reply)) break;
+    if (reply.size() != 3 ||
+        !game_record::valid_dot(reply) ||
+        (reply[2] != VERTICAL && reply[2] != HORIZONTAL)) {
+      return fail("no reply");
+    }
+    const PlayerMove reference{parse_dot(reply), reply[2]};
+    if (!pos.possible_move(reference.dot, reference.orientation)) {
+      return fail("illegal reply " + reply);
+    }
+
+    // a distinct, reproducible random stream for every move, as the player
+    const auto seed =
+        options.seed ^ (0x9e3779b9u * static_cast<uint32_t>(pos.turn + 1));
+    auto& result = results.emplace_back(
+        search_move(pos, weights, color, seed, options.simulations));
+    result.reference = reference;
+    for (int r = 1; r < options.repeats; ++r) {
+      auto other = search_move(pos, weights, color, seed + 7919u * r,
+                               options.simulations);
+      result.agreeing += other.move.code() == result.move.code();
+    }
+    pos.do_move(reference);
+  }
+  return results;
+}
+
+double percentile(vector<double> values, double p) {
+  if (values.empty()) return 0.0;
+  auto k = static_cast<size_t>(p * static_cast<double>(values.size() - 1));
+  std::nth_element(values.begin(), values.begin() + k, values.end());
+  return values[k];
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const auto options = parse_options(argc, argv);
+  ofstream out(options.output);
+  out << fixed << setprecision(2);
+  cout << "transcripts=" << options.transcripts.size()
+       << " simulations=" << options.simulations
+       << " repeats=" << options.repeats << endl;
+
+  int errors{0};
+  int moves{0};
+  int matches{0};
+  int agreeing{0};
+  int64_t simulations{0};
+  double time{0.0};
+  size_t max_memory{0};
+  vector<double> latencies;
+  for (const auto& path : options.transcripts) {
+    ifstream in(path);
+    string error{"cannot read"};
+    auto results = in ? replay(in, options, error) : nullopt;
+    if (!results) {
+      cerr << path << ": " << error << endl;
+      ++errors;
+      continue;
+    }
+    int game_matches{0};
+    for (const auto& result : *results) {
+      const bool match = result.move.code() == result.reference.code();
+      game_matches += match;
+      agreeing += result.agreeing;
+      simulations += result.simulations;
+      time += result.latency;
+      max_memory = max(max_memory, result.memory);
+      latencies.push_back(result.latency);
+      out << path << " " << result.turn << " " << result.move.show() << " "
+          << result.reference.show() << " " << match << " "
+          << 1e3 * result.latency << " " << result.simulations << " "
+          << 1e-3 * result.simulations / result.latency << " "
+          << result.afterstates << " " << result.states << " "
+          << result.memory / 1024 << " " << result.agreeing << "/"
+          << options.repeats - 1 << "\n";
+    }
+    moves += static_cast<int>(results->size());
+    matches += game_matches;
+    cout << path << " moves=" << results->size()
+         << " matches=" << game_matches << endl;
+  }
+  if (!out) {
+    cerr << "cannot write " << options.output << endl;
+    return 1;
+  }
+
+  cout << fixed << setprecision(1) << "moves=" << moves
+       << " errors=" << errors << " matches="
+       << 100.0 * matches / max(moves, 1) << "%";
+  if (options.repeats > 1) {
+    cout << " stability="
+         << 100.0 * agreeing / max(moves * (options.repeats - 1), 1) << "%";
+  }
+  cout << " latency p50=" << 1e3 * percentile(latencies, 0.50)
+       << "ms p90=" << 1e3 * percentile(latencies, 0.90)
+       << "ms max=" << 1e3 * percentile(latencies, 1.0) << "ms"
+       << " speed=" << 1e-3 * static_cast<double>(simulations) / max(time, 1e-9)
+       << " Ki/s max-memory=" << max_memory / 1024 << "KB" << endl;
+  return errors > 0 ? 1 : 0;
+}
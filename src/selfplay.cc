@@ -0,0 +1,166 @@
+// Self-play generator of training data.
+//
+//   selfplay [--games N] [--threads N] [--simulations N] [--block N]
+//            [--seed S] [--output PATH]
+//
+// Both seats of a game are searched for a fixed number of simulations per
+// move, with fewer warmup rollouts than the player since the budget is
+// small. Every searched position is recorded with its visit distribution,
+// and the result of the game is filled in once it ends (see TrainingData.h).
+#include "MctsAi.h"
+#include "TrainingData.h"
+
+namespace {
+
+using namespace mcts_ai;
+
+using SelfPlayPolicies =
+    Policies<ProgressiveBias<>, SqrtWidening<>, UniformRollout, MeanBackup,
+             100>;
+
+struct Options {
+  int games{100};
+  int threads{static_cast<int>(thread::hardware_concurrency())};
+  int simulations{800};
+  int block{256};
+  uint32_t seed{20240601};
+  string output{"selfplay.bin"};
+};
+
+void usage() {
+  cerr << "usage: selfplay [--games N] [--threads N] [--simulations N]"
+       << " [--block N] [--seed S] [--output PATH]" << endl;
+  std::exit(2);
+}
+
+Options parse_options(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    auto next = [&]() -> string {
+      if (i + 1 >= argc) usage();
+      return argv[++i];
+    };
+    if (arg == "--games") {
+      options.games = std::stoi(next());
+    } else if (arg == "--threads") {
+      options.threads = std::stoi(next());
+    } else if (arg == "--simulations") {
+      options.simulations = std::stoi(next());
+    } else if (arg == "--block") {
+      options.block = std::stoi(next());
+    } else if (arg == "--seed") {
+      options.seed = static_cast<uint32_t>(std::stoul(next()));
+    } else if (arg == "--output") {
+      options.output = next();
+    } else {
+      usage();
+    }
+  }
+  options.threads = max(options.threads, 1);
+  // the root visits index the BONUS and SQRT tables
+  options.simulations =
+      std::clamp(options.simulations, 1, mcts_ai::MAX_VISITS - 1);
+  options.block = max(options.block, 1);
+  return options;
+}
+
+// Plays game number `game` and appends its records to `records`.
+void play_game(const Options& options, int game,
+               vector<training_data::Record>& records) {
+  FastRandom rng{options.seed + 7919u * static_cast<uint32_t>(game + 1)};
+  array<Color, 2> colors;
+  colors[0] = static_cast<Color>('1' + rng.less_than(MAX_COLORS));
+  do {
+    colors[1] = static_cast<Color>('1' + rng.less_than(MAX_COLORS));
+  } while (colors[1] == colors[0]);
+  const array<ColorWeights, 2> weights{ColorWeights{colors[0]},
+                                       ColorWeights{colors[1]}};
+
+  const auto first = records.size();
+  auto start_tile = rng.less_than(TILES_PERMUTATIONS_COUNT);
+  Position pos{"Hh" + string{show_tile(TILES_PERMUTATIONS[start_tile])} +
+               HORIZONTAL};
+  for (int seat = 0; !pos.end_game(); seat = 1 - seat) {
+    pos.play_chance_move(rng);
+    const auto seed = options.seed ^ (0x9e3779b9u * static_cast<uint32_t>(
+                                          game * 64 + pos.turn + 1));
+    Search<SelfPlayPolicies> search{weights[seat], colors[seat], seed};
+    search.start(pos, options.simulations);
+    search.run_for(options.simulations);
+    const auto root = search.root_stats();
+
+    auto& record = records.emplace_back(
+        training_data::make_record(pos, colors[seat]));
+    for (const auto& child : root.children) {
+      record.visits[child.tile_info->code] = static_cast<uint16_t>(
+          int64_t{training_data::VISITS_SCALE} * child.visits / root.visits);
+    }
+    pos.do_move(search.best_move());
+    search.stop();
+  }
+
+  const array<int, 2> scores{pos.get_score(colors[0] - '1'),
+                             pos.get_score(colors[1] - '1')};
+  for (auto i = first; i < records.size(); ++i) {
+    auto& record = records[i];
+    const int seat = record.color == colors[0] ? 0 : 1;
+    record.score = static_cast<int16_t>(scores[seat]);
+    record.opponent_score = static_cast<int16_t>(scores[1 - seat]);
+    record.outcome = static_cast<int8_t>((scores[seat] > scores[1 - seat]) -
+                                         (scores[seat] < scores[1 - seat]));
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const auto options = parse_options(argc, argv);
+  training_data::Writer writer{options.output};
+  if (!writer.good()) {
+    cerr << "cannot write " << options.output << endl;
+    return 1;
+  }
+  cout << "games=" << options.games << " threads=" << options.threads
+       << " simulations=" << options.simulations << endl;
+
+  auto start = get_time_point();
+  atomic<int> next_game{0};
+  atomic<size_t> positions{0};
+
+  auto worker = [&]() {
+    vector<training_data::Record> records;
+    records.reserve(2 * options.block);
+    for (auto game = next_game++; game < options.games; game = next_game++) {
+      play_game(options, game, records);
+      // blocks hold whole games
+      if (records.size() >= static_cast<size_t>(options.block)) {
+        writer.write_block(records);
+        positions += records.size();
+        records.clear();
+      }
+      if ((game + 1) % 100 == 0) {
+        auto dt = get_delta_time_since(start);
+        cout << game + 1 << "/" << options.games << " elapsed=" << dt
+             << "s positions=" << positions << endl;
+      }
+    }
+    writer.write_block(records);
+    positions += records.size();
+  };
+
+  vector<thread> workers;
+  for (int i = 1; i < options.threads; ++i) workers.emplace_back(worker);
+  worker();
+  for (auto& w : workers) w.join();
+
+  auto dt = get_delta_time_since(start);
+  cout << fixed << setprecision(1) << "wrote " << positions << " positions to "
+       << options.output << " in " << dt << "s, "
+       << 3600.0 * static_cast<double>(positions) / dt << " positions/h, "
+       << static_cast<double>(writer.compressed_size()) /
+              static_cast<double>(max(positions.load(), size_t{1}))
+       << " bytes/position (raw " << sizeof(training_data::Record) << ")"
+       << endl;
+  return writer.good() ? 0 : 1;
+}
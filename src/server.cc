@@ -0,0 +1,359 @@
+// Game server hosting many games of the player in one process.
+//
+//   server <socket> [--workers N]
+//   server <socket> --connect
+//
+// Each connection to the UNIX socket is one game in the line protocol of
+// main.cc (see GameSession.h), with its own position, opponent weights and
+// clock. The tables, the opening book and the telemetry file are loaded
+// once for all of them. A session costs nothing while its opponent thinks.
+// When it has a tile to place, its search goes to a pool of N worker
+// threads shared by all the sessions. The time a search waits for a worker
+// counts as used by its game. SIGINT or SIGTERM stops the server after the
+// searches in progress. An endgame solve shares out its root moves to
+// cores / N threads, so that the searches of the pool fill the cores at
+// most once.
+//
+// With --connect the program relays its stdin and stdout to a new session
+// of the server. A referee that starts a program per game, such as the
+// arena, then plays against the server through a script running
+// `exec server /tmp/box.sock --connect`.
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <deque>
+
+#include "GameSession.h"
+
+namespace {
+
+struct Options {
+  string socket;
+  int workers{static_cast<int>(thread::hardware_concurrency())};
+  bool connect{false};
+};
+
+void usage() {
+  cerr << "usage: server <socket> [--workers N]" << endl
+       << "       server <socket> --connect" << endl;
+  std::exit(2);
+}
+
+Options parse_options(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    auto next = [&]() -> string {
+      if (i + 1 >= argc) usage();
+      return argv[++i];
+    };
+    if (arg == "--workers") {
+      options.workers = std::stoi(next());
+    } else if (arg == "--connect") {
+      options.connect = true;
+    } else if (options.socket.empty() && !arg.starts_with("--")) {
+      options.socket = arg;
+    } else {
+      usage();
+    }
+  }
+  if (options.socket.empty()) usage();
+  options.workers = max(options.workers, 1);
+  return options;
+}
+
+optional<sockaddr_un> socket_address(const string& path) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) return nullopt;
+  std::copy(path.begin(), path.end(), address.sun_path);
+  return address;
+}
+
+bool write_all(int fd, string_view data) {
+  while (!data.empty()) {
+    auto n = write(fd, data.data(), data.size());
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    data.remove_prefix(static_cast<size_t>(n));
+  }
+  return true;
+}
+
+// Copies stdin to a session of the server and the replies to stdout.
+int relay(const string& path) {
+  auto address = socket_address(path);
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (!address || fd < 0 ||
+      connect(fd, reinterpret_cast<const sockaddr*>(&*address),
+              sizeof(*address)) != 0) {
+    cerr << "cannot connect to " << path << endl;
+    return 1;
+  }
+  array<pollfd, 2> fds{pollfd{STDIN_FILENO, POLLIN, 0},
+                       pollfd{fd, POLLIN, 0}};
+  char chunk[4096];
+  while (true) {
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    if (fds[0].revents) {
+      auto n = read(STDIN_FILENO, chunk, sizeof(chunk));
+      if (n > 0) {
+        if (!write_all(fd, {chunk, static_cast<size_t>(n)})) break;
+      } else {
+        // the server ends the session after the end of its input
+        shutdown(fd, SHUT_WR);
+        fds[0].fd = -1;
+      }
+    }
+    if (fds[1].revents) {
+      auto n = read(fd, chunk, sizeof(chunk));
+      if (n <= 0 ||
+          !write_all(STDOUT_FILENO, {chunk, static_cast<size_t>(n)})) {
+        break;
+      }
+    }
+  }
+  close(fd);
+  return 0;
+}
+
+// A game over one connection. While `busy`, a worker searches the move of
+// the session and writes it, and the event loop only reads into `input`.
+struct Connection {
+  int fd;
+  null_ostream log;
+  GameSession session;
+  // words not read by the session yet
+  string input;
+  bool end_of_input{false};
+  bool game_over{false};
+  atomic<bool> busy{false};
+  // of the tile being searched
+  decltype(get_time_point()) arrival;
+
+  Connection(int fd, const GameSession::Settings& settings)
+      : fd(fd), session(log, settings) {}
+
+  Connection(const Connection&) = delete;
+  Connection& operator=(const Connection&) = delete;
+
+  ~Connection() { close(fd); }
+
+  // Feeds the session the complete words of the input, until it has a move
+  // to search. Returns true if it has.
+  bool feed() {
+    constexpr string_view SPACES{" \t\r\n"};
+    while (!game_over) {
+      auto begin = input.find_first_not_of(SPACES);
+      if (begin == string::npos) {
+        input.clear();
+        return false;
+      }
+      auto end = input.find_first_of(SPACES, begin);
+      // the last word may be incomplete
+      if (end == string::npos && !end_of_input) {
+        input.erase(0, begin);
+        return false;
+      }
+      auto word = input.substr(begin, end - begin);
+      input.erase(0, end);
+      switch (session.read(word)) {
+        case GameSession::Step::READ:
+          break;
+        case GameSession::Step::MOVE:
+          return true;
+        case GameSession::Step::ERROR:
+          cerr << "session " << fd << ": unexpected " << word << endl;
+          [[fallthrough]];
+        case GameSession::Step::QUIT:
+          game_over = true;
+          break;
+      }
+    }
+    return false;
+  }
+
+  bool finished() const { return game_over || end_of_input; }
+};
+
+// Searches of all the sessions, in the order their tiles arrived.
+class WorkerPool {
+ public:
+  // `done` is called by the worker after each search
+  WorkerPool(int workers, function<void()> done) : done(std::move(done)) {
+    for (int i = 0; i < workers; ++i) threads.emplace_back([this] { run(); });
+  }
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  // after the searches in progress, the queued ones are dropped
+  ~WorkerPool() {
+    {
+      lock_guard lock(jobs_mutex);
+      stopping = true;
+    }
+    jobs_ready.notify_all();
+    for (auto& t : threads) t.join();
+  }
+
+  void submit(shared_ptr<Connection> connection) {
+    connection->busy = true;
+    connection->arrival = get_time_point();
+    {
+      lock_guard lock(jobs_mutex);
+      jobs.push_back(std::move(connection));
+    }
+    jobs_ready.notify_one();
+  }
+
+  int moves_count() const { return moves; }
+
+ private:
+  void run() {
+    while (true) {
+      shared_ptr<Connection> connection;
+      {
+        std::unique_lock lock(jobs_mutex);
+        jobs_ready.wait(lock, [this] { return stopping || !jobs.empty(); });
+        if (stopping) return;
+        connection = std::move(jobs.front());
+        jobs.pop_front();
+      }
+      auto waited = get_delta_time_since(connection->arrival);
+      auto reply = connection->session.move(waited) + "\n";
+      // a client gone is noticed by the event loop
+      write_all(connection->fd, reply);
+      ++moves;
+      connection->busy.store(false, std::memory_order_release);
+      done();
+    }
+  }
+
+  function<void()> done;
+  mutex jobs_mutex;
+  condition_variable jobs_ready;
+  std::deque<shared_ptr<Connection>> jobs;
+  bool stopping{false};
+  atomic<int> moves{0};
+  vector<thread> threads;
+};
+
+// written to by the signal handler and the workers to wake the event loop
+int wake_fd{-1};
+volatile sig_atomic_t stop_requested{0};
+
+void on_signal(int) {
+  stop_requested = 1;
+  [[maybe_unused]] auto n = write(wake_fd, "s", 1);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  signal(SIGPIPE, SIG_IGN);
+  const auto options = parse_options(argc, argv);
+  if (options.connect) return relay(options.socket);
+
+  auto address = socket_address(options.socket);
+  int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  unlink(options.socket.c_str());
+  if (!address || listener < 0 ||
+      bind(listener, reinterpret_cast<const sockaddr*>(&*address),
+           sizeof(*address)) != 0 ||
+      listen(listener, SOMAXCONN) != 0) {
+    cerr << "cannot listen on " << options.socket << endl;
+    return 1;
+  }
+  int wake[2];
+  if (pipe2(wake, O_CLOEXEC | O_NONBLOCK) != 0) return 1;
+  wake_fd = wake[1];
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+
+  PlayerEnvironment environment{cerr};
+  environment.settings.endgame_threads = max(
+      static_cast<int>(thread::hardware_concurrency()) / options.workers, 1);
+  cerr << "listening on " << options.socket << " workers=" << options.workers
+       << endl;
+  const auto start = get_time_point();
+  int sessions{0};
+  int games{0};
+  map<int, shared_ptr<Connection>> connections;
+  WorkerPool pool{options.workers, [] {
+                    [[maybe_unused]] auto n = write(wake_fd, "w", 1);
+                  }};
+
+  // feeds an idle session and ends it once its game is over
+  auto serve = [&](const shared_ptr<Connection>& connection) {
+    if (connection->busy.load(std::memory_order_acquire)) return;
+    if (connection->feed()) {
+      pool.submit(connection);
+    } else if (connection->finished()) {
+      games += connection->session.moves_count() > 0;
+      connections.erase(connection->fd);
+    }
+  };
+
+  vector<pollfd> fds;
+  vector<shared_ptr<Connection>> polled;
+  while (!stop_requested) {
+    fds = {pollfd{listener, POLLIN, 0}, pollfd{wake[0], POLLIN, 0}};
+    polled.clear();
+    for (const auto& [fd, connection] : connections) {
+      if (connection->end_of_input) continue;
+      fds.push_back({fd, POLLIN, 0});
+      polled.push_back(connection);
+    }
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    if (fds[1].revents) {
+      char drain[64];
+      while (read(wake[0], drain, sizeof(drain)) > 0) {
+      }
+      // sessions whose search finished may have input left
+      for (auto it = connections.begin(); it != connections.end();) {
+        auto connection = (it++)->second;
+        serve(connection);
+      }
+    }
+    for (size_t i = 0; i < polled.size(); ++i) {
+      if (!fds[i + 2].revents) continue;
+      auto& connection = polled[i];
+      char chunk[4096];
+      auto n = read(connection->fd, chunk, sizeof(chunk));
+      if (n > 0) {
+        connection->input.append(chunk, static_cast<size_t>(n));
+      } else if (n == 0 || errno != EINTR) {
+        connection->end_of_input = true;
+      }
+      serve(connection);
+    }
+    if (fds[0].revents) {
+      int fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+      if (fd >= 0) {
+        ++sessions;
+        connections.emplace(
+            fd, make_shared<Connection>(fd, environment.settings));
+      }
+    }
+  }
+
+  close(listener);
+  unlink(options.socket.c_str());
+  auto dt = get_delta_time_since(start);
+  cerr << fixed << setprecision(1) << "sessions=" << sessions
+       << " games=" << games << " moves=" << pool.moves_count()
+       << " time=" << dt << "s"
+       << " games/h=" << 3600.0 * games / max(dt, 1e-9) << endl;
+  return 0;
+}
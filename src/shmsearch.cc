@@ -0,0 +1,151 @@
+// Search of one position by worker processes sharing a tree in /dev/shm.
+//
+//   shmsearch <position> [--workers N] [--time SEC] [--nodes N]
+//             [--name NAME] [--compare]
+//
+// The position is one line of GameRecord.h, such as
+// "3 Hh123456h Gg654321v 415263". The coordinator creates the segment,
+// /box-tree-<pid> unless --name gives another, and fails if it exists
+// already. It then forks the workers (see SharedTree.h). It respawns any worker that dies,
+// the tree staying in the segment, then stops them all after --time
+// seconds and plays the most visited move of the root. With --compare the
+// in-process search runs on the position for the same time afterwards.
+#include <sys/wait.h>
+
+#include "GameRecord.h"
+#include "SharedTree.h"
+
+namespace {
+
+struct Options {
+  string position;
+  int workers{static_cast<int>(thread::hardware_concurrency())};
+  double time{1.0};
+  uint32_t nodes{1u << 19};
+  // default /box-tree-<pid>, so that searches on one host do not collide
+  string name;
+  bool compare{false};
+};
+
+void usage() {
+  cerr << "usage: shmsearch <position> [--workers N] [--time SEC]"
+       << " [--nodes N] [--name NAME] [--compare]" << endl;
+  std::exit(2);
+}
+
+Options parse_options(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    auto next = [&]() -> string {
+      if (i + 1 >= argc) usage();
+      return argv[++i];
+    };
+    if (arg == "--workers") {
+      options.workers = std::stoi(next());
+    } else if (arg == "--time") {
+      options.time = std::stod(next());
+    } else if (arg == "--nodes") {
+      options.nodes = static_cast<uint32_t>(std::stoul(next()));
+    } else if (arg == "--name") {
+      options.name = next();
+    } else if (arg == "--compare") {
+      options.compare = true;
+    } else if (options.position.empty() && !arg.starts_with("--")) {
+      options.position = arg;
+    } else {
+      usage();
+    }
+  }
+  if (options.position.empty()) usage();
+  options.workers = max(options.workers, 1);
+  if (options.name.empty()) {
+    options.name = "/box-tree-" + to_string(getpid());
+  }
+  return options;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const auto options = parse_options(argc, argv);
+  auto record = game_record::parse_position(options.position);
+  if (!record) {
+    cerr << "not a position: " << options.position << endl;
+    return 2;
+  }
+  const auto& [color, pos] = *record;
+  const ColorWeights weights{color};
+
+  shared_tree::Segment segment{options.name, options.nodes};
+  if (!segment.valid()) {
+    cerr << "cannot create the segment " << options.name << endl;
+    return 1;
+  }
+  auto& info = segment.info();
+
+  // the tree is searched from the canonical mirror image of the position
+  auto root_pos = pos;
+  const auto symmetry = root_pos.get_canonical_symmetry();
+  root_pos.mirror(symmetry);
+  root_pos.update_condidates();
+  auto root = segment.find_or_create(root_pos).first;
+
+  auto start = get_time_point();
+  auto spawn = [&](int index) {
+    auto pid = fork();
+    if (pid == 0) {
+      shared_tree::run_worker(segment, pos, root_pos, symmetry, weights, color,
+                              0x9e3779b9u * static_cast<uint32_t>(index + 1));
+      // the segment belongs to the coordinator
+      _exit(0);
+    }
+    return pid;
+  };
+  vector<pid_t> workers;
+  for (int i = 0; i < options.workers; ++i) workers.push_back(spawn(i));
+
+  int respawned{0};
+  while (get_delta_time_since(start) < options.time) {
+    usleep(5'000);
+    for (auto& pid : workers) {
+      if (pid > 0 && waitpid(pid, nullptr, WNOHANG) == 0) continue;
+      cerr << "worker " << pid << " died, respawning" << endl;
+      pid = spawn(options.workers + respawned++);
+    }
+  }
+  info.stop.store(1);
+  for (auto pid : workers) {
+    if (pid > 0) waitpid(pid, nullptr, 0);
+  }
+  auto dt = get_delta_time_since(start);
+
+  auto [best, visits] = shared_tree::most_visited(segment, *root, symmetry);
+  if (!best) {
+    cerr << "no simulation finished" << endl;
+    return 1;
+  }
+  const auto simulations = info.simulations.load();
+  cout << fixed << setprecision(2) << "best-move=" << best->move().show()
+       << " visits=" << visits << " root-visits=" << root->visits.load()
+       << " simulations=" << simulations << " nodes=" << info.nodes.load()
+       << "/" << info.node_capacity << " respawned=" << respawned
+       << " time=" << dt << "s"
+       << " speed=" << 1e-3 * static_cast<double>(simulations) / dt
+       << " Ki/s" << endl;
+
+  if (options.compare) {
+    mcts_ai::Search<> search{weights, color, 0x9e3779b9u};
+    auto compare_start = get_time_point();
+    search.start(pos);
+    search.run_for(options.time - get_delta_time_since(compare_start));
+    auto compare_dt = get_delta_time_since(compare_start);
+    cout << "in-process best-move=" << search.best_move().show()
+         << " simulations=" << search.simulations_count()
+         << " speed="
+         << 1e-3 * static_cast<double>(search.simulations_count()) /
+                compare_dt
+         << " Ki/s" << endl;
+  }
+  return 0;
+}